@@ -0,0 +1,329 @@
+/* bench_mem.c - Host-side allocator benchmark for memory.c
+ *
+ * Built by `make bench-mem`. memory.c and page.c are compiled natively and
+ * linked against the stubs below: a fake physical memory block standing in
+ * for everything after __kernel_end, a quiet printf_serial, and a software
+ * page table for the stack window mappings. Every trace uses a fixed seed,
+ * so runs are reproducible and comparable across allocator changes.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+/* Kernel interfaces (memory.h cannot be mixed with libc headers) */
+typedef struct {
+    uint32_t used_bytes;
+    uint32_t heap_bytes;
+    uint32_t heap_free_bytes;
+    uint32_t heap_free_blocks;
+    uint32_t largest_free_block;
+    uint32_t free_pages;
+    uint32_t largest_free_pages;
+} heap_info_t;
+
+void page_init(void* mbi);
+void memory_init(void);
+void* kmalloc(uint32_t size);
+void kfree(void* ptr);
+void memory_stats(void);
+void memory_heap_info(heap_info_t* info);
+uint32_t allocate_stack(int slot, int pid, uint32_t size);
+void free_stack(int slot);
+int memory_stack_fault(uintptr_t addr);
+
+#define BENCH_RAM_SIZE    (64u << 20)
+#define PAGE_SIZE         4096u
+#define STACK_VIRT_BASE   0xD0000000u
+#define STACK_WINDOW_SIZE 0x00020000u
+#define MAX_PROCESSES     32
+#define SAMPLES           16
+
+/* ------------------------------------------------------------------ */
+/* Stubs                                                               */
+/* ------------------------------------------------------------------ */
+
+/* Fake physical memory; page.c places its frame array at the start */
+uint8_t __kernel_end[BENCH_RAM_SIZE] __attribute__((aligned(4096)));
+
+static int verbose = 0;
+
+void printf_serial(const char* format, ...) {
+    if (!verbose && !strstr(format, "Error")) return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+/* Page table for the stack windows only */
+#define STACK_PTES (MAX_PROCESSES * STACK_WINDOW_SIZE / PAGE_SIZE)
+static uintptr_t stack_ptes[STACK_PTES];
+
+int paging_map(uintptr_t virt, uintptr_t phys, uint32_t flags) {
+    (void)flags;
+    stack_ptes[(virt - STACK_VIRT_BASE) / PAGE_SIZE] = phys;
+    return 1;
+}
+
+uintptr_t paging_unmap(uintptr_t virt) {
+    uintptr_t* pte = &stack_ptes[(virt - STACK_VIRT_BASE) / PAGE_SIZE];
+    uintptr_t phys = *pte;
+    *pte = 0;
+    return phys;
+}
+
+/* Multiboot info with a single available region covering the fake RAM */
+struct mmap_entry {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed));
+
+static struct mmap_entry bench_mmap[1];
+static uint32_t bench_mbi[22];
+
+static void bench_reset(void) {
+    memset(stack_ptes, 0, sizeof(stack_ptes));
+    bench_mmap[0].size = sizeof(bench_mmap[0]) - sizeof(uint32_t);
+    bench_mmap[0].addr = (uintptr_t)__kernel_end;
+    bench_mmap[0].len = BENCH_RAM_SIZE;
+    bench_mmap[0].type = 1;
+    memset(bench_mbi, 0, sizeof(bench_mbi));
+    bench_mbi[0] = 0x40;                                  /* flags: memory map */
+    bench_mbi[11] = sizeof(bench_mmap);                   /* mmap_length */
+    bench_mbi[12] = (uint32_t)(uintptr_t)bench_mmap;      /* mmap_addr */
+    page_init(bench_mbi);
+    memory_init();
+}
+
+/* ------------------------------------------------------------------ */
+/* Measurement                                                         */
+/* ------------------------------------------------------------------ */
+
+static uint64_t rng_state;
+
+static uint32_t rng_next(void) {
+    /* xorshift64 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+typedef struct {
+    const char* name;
+    uint32_t* lat;              /* Per-op cycles */
+    uint32_t ops;
+    uint32_t cap;
+    uint64_t start_ns;
+    uint64_t total_ns;
+    double peak_frag;
+    uint32_t sample_every;
+    uint32_t next_sample;
+    uint32_t samples;
+    uint32_t largest[SAMPLES];
+    uint32_t failures;
+} trace_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void trace_begin(trace_t* t, const char* name, uint32_t planned_ops) {
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->cap = planned_ops;
+    t->lat = malloc(sizeof(uint32_t) * planned_ops);
+    t->sample_every = planned_ops / SAMPLES ? planned_ops / SAMPLES : 1;
+    t->next_sample = t->sample_every;
+    bench_reset();
+    t->start_ns = now_ns();
+}
+
+/* External fragmentation of the first-fit heap: 1 - largest / free */
+static void trace_sample(trace_t* t) {
+    heap_info_t info;
+    memory_heap_info(&info);
+    if (info.heap_free_bytes) {
+        double frag = 1.0 - (double)info.largest_free_block / info.heap_free_bytes;
+        if (frag > t->peak_frag) t->peak_frag = frag;
+    }
+    if (t->samples < SAMPLES) {
+        t->largest[t->samples++] = info.largest_free_block;
+    }
+}
+
+static void trace_record(trace_t* t, uint64_t cycles) {
+    if (t->ops < t->cap) t->lat[t->ops] = cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)cycles;
+    t->ops++;
+    if (t->ops >= t->next_sample) {
+        uint64_t paused = now_ns();
+        trace_sample(t);
+        t->start_ns += now_ns() - paused;   /* Sampling is not part of the run */
+        t->next_sample += t->sample_every;
+    }
+}
+
+static void* timed_kmalloc(trace_t* t, uint32_t size) {
+    uint64_t c0 = __rdtsc();
+    void* p = kmalloc(size);
+    trace_record(t, __rdtsc() - c0);
+    if (!p) t->failures++;
+    return p;
+}
+
+static void timed_kfree(trace_t* t, void* p) {
+    uint64_t c0 = __rdtsc();
+    kfree(p);
+    trace_record(t, __rdtsc() - c0);
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void trace_end(trace_t* t) {
+    t->total_ns = now_ns() - t->start_ns;
+    uint32_t n = t->ops < t->cap ? t->ops : t->cap;
+    qsort(t->lat, n, sizeof(uint32_t), cmp_u32);
+    
+    printf("%-14s %9u ops %12.0f ops/s  p50 %5u cyc  p99 %6u cyc  peak frag %5.1f%%",
+           t->name, t->ops, t->ops / (t->total_ns / 1e9),
+           n ? t->lat[n / 2] : 0, n ? t->lat[(uint64_t)n * 99 / 100] : 0,
+           t->peak_frag * 100.0);
+    if (t->failures) printf("  (%u failed)", t->failures);
+    printf("\n  largest free block (KB):");
+    for (uint32_t i = 0; i < t->samples; i++) {
+        printf(" %u", t->largest[i] / 1024);
+    }
+    printf("\n");
+    free(t->lat);
+}
+
+/* ------------------------------------------------------------------ */
+/* Traces                                                              */
+/* ------------------------------------------------------------------ */
+
+/* send_message pattern: a small header plus a payload per message, freed
+   in FIFO order by the receiver while the queue stays roughly 64 deep */
+static void trace_ipc_churn(uint32_t messages) {
+    enum { DEPTH = 64 };
+    trace_t t;
+    void* hdr[DEPTH] = {0};
+    void* data[DEPTH] = {0};
+    
+    rng_state = 0x1BADB002;
+    trace_begin(&t, "ipc-churn", messages * 4);
+    for (uint32_t i = 0; i < messages; i++) {
+        uint32_t slot = i % DEPTH;
+        if (hdr[slot]) {
+            timed_kfree(&t, data[slot]);
+            timed_kfree(&t, hdr[slot]);
+        }
+        hdr[slot] = timed_kmalloc(&t, 20);
+        data[slot] = timed_kmalloc(&t, 16 + rng_next() % 241);
+    }
+    for (uint32_t i = 0; i < DEPTH; i++) {
+        if (hdr[i]) {
+            kfree(data[i]);
+            kfree(hdr[i]);
+        }
+    }
+    trace_end(&t);
+}
+
+/* Process create/destroy storm: reserve a stack, fault in a few pages,
+   allocate a couple of per-process objects, tear everything down */
+static void trace_stack_storm(uint32_t rounds) {
+    trace_t t;
+    int live[MAX_PROCESSES] = {0};
+    void* objs[MAX_PROCESSES][2];
+    
+    rng_state = 0x2BADB002;
+    trace_begin(&t, "stack-storm", rounds * 3);
+    for (uint32_t i = 0; i < rounds; i++) {
+        int slot = 1 + (int)(rng_next() % (MAX_PROCESSES - 1));
+        if (live[slot]) {
+            uint64_t c0 = __rdtsc();
+            free_stack(slot);
+            trace_record(&t, __rdtsc() - c0);
+            timed_kfree(&t, objs[slot][0]);
+            timed_kfree(&t, objs[slot][1]);
+            live[slot] = 0;
+            continue;
+        }
+        
+        uint32_t size = PAGE_SIZE << (rng_next() % 4);
+        uint64_t c0 = __rdtsc();
+        uint32_t top = allocate_stack(slot, slot, size);
+        uint32_t touched = 1 + rng_next() % (size / PAGE_SIZE);
+        for (uint32_t p = 1; p <= touched; p++) {
+            memory_stack_fault(top - p * PAGE_SIZE);
+        }
+        trace_record(&t, __rdtsc() - c0);
+        objs[slot][0] = timed_kmalloc(&t, 64);
+        objs[slot][1] = timed_kmalloc(&t, 512);
+        live[slot] = 1;
+    }
+    for (int slot = 0; slot < MAX_PROCESSES; slot++) {
+        if (live[slot]) {
+            free_stack(slot);
+            kfree(objs[slot][0]);
+            kfree(objs[slot][1]);
+        }
+    }
+    trace_end(&t);
+}
+
+/* Random sizes from 8B to 64KB (mostly small), random lifetimes */
+static void trace_random(uint32_t ops) {
+    enum { LIVE = 4096 };
+    trace_t t;
+    static void* ptrs[LIVE];
+    memset(ptrs, 0, sizeof(ptrs));
+    
+    rng_state = 0x3BADB002;
+    trace_begin(&t, "random-sizes", ops);
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t idx = rng_next() % LIVE;
+        if (ptrs[idx]) {
+            timed_kfree(&t, ptrs[idx]);
+            ptrs[idx] = NULL;
+        } else {
+            uint32_t shift = 3 + rng_next() % 14;      /* 8B .. 64KB */
+            uint32_t size = (1u << shift) + rng_next() % (1u << shift);
+            if (rng_next() % 4) size = 8 + rng_next() % 256;
+            ptrs[idx] = timed_kmalloc(&t, size);
+        }
+    }
+    for (uint32_t i = 0; i < LIVE; i++) {
+        if (ptrs[i]) kfree(ptrs[i]);
+    }
+    trace_end(&t);
+}
+
+int main(int argc, char** argv) {
+    uint32_t scale = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) verbose = 1;
+        else scale = (uint32_t)atoi(argv[i]);
+    }
+    if (scale == 0) scale = 1;
+    
+    printf("kacchiOS allocator benchmark (%u MB fake RAM, latencies in TSC cycles)\n",
+           BENCH_RAM_SIZE >> 20);
+    trace_ipc_churn(200000 * scale);
+    trace_stack_storm(100000 * scale);
+    trace_random(400000 * scale);
+    
+    if (verbose) memory_stats();
+    return 0;
+}
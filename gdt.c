@@ -0,0 +1,127 @@
+/* gdt.c - Flat segments plus the two hardware tasks, one set per CPU */
+#include "gdt.h"
+#include "smp.h"
+
+#define GDT_ENTRIES      6
+#define FAULT_STACK_SIZE 4096
+
+typedef struct {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t granularity;        // Flags in the high nibble, limit 19:16 low
+    uint8_t base_high;
+} __attribute__((packed)) gdt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+// Every CPU has its own table. The selectors are the same everywhere, but
+// GDT_TSS_MAIN, GDT_TSS_FAULT and GDT_PERCPU name that CPU's own TSSs and
+// cpu_t, so the shared IDT's task gate works on all of them at once.
+static gdt_entry_t gdt[MAX_CPUS][GDT_ENTRIES];
+static gdt_ptr_t gdt_ptr[MAX_CPUS];
+
+// Page faults are delivered through a task gate. A fault on a lazily mapped
+// stack cannot be handled on that same stack (the CPU would fault again while
+// pushing the exception frame), so the handler gets its own task and stack.
+static tss_t main_tss[MAX_CPUS];
+static tss_t fault_tss[MAX_CPUS];
+static uint8_t fault_stack[MAX_CPUS][FAULT_STACK_SIZE] __attribute__((aligned(16)));
+
+extern void page_fault_task(void);  // isr.S
+
+static void gdt_set_entry(gdt_entry_t* table, int index, uint32_t base, uint32_t limit,
+                          uint8_t access, uint8_t flags) {
+    table[index].limit_low = limit & 0xFFFF;
+    table[index].base_low = base & 0xFFFF;
+    table[index].base_mid = (base >> 16) & 0xFF;
+    table[index].access = access;
+    table[index].granularity = (uint8_t)((flags & 0xF0) | ((limit >> 16) & 0x0F));
+    table[index].base_high = (base >> 24) & 0xFF;
+}
+
+// BSP: build and load the CPU 0 tables
+void gdt_init(void) {
+    gdt_setup_cpu(0);
+    gdt_load_cpu(0);
+}
+
+// Fill in the tables of `cpu`; the BSP does this for each AP before
+// starting it
+void gdt_setup_cpu(int cpu) {
+    gdt_entry_t* table = gdt[cpu];
+    tss_t* main = &main_tss[cpu];
+    tss_t* fault = &fault_tss[cpu];
+    cpu_t* percpu = smp_cpu(cpu);
+    
+    memset(main, 0, sizeof(*main));
+    memset(fault, 0, sizeof(*fault));
+    main->iomap_base = sizeof(tss_t);
+    main->cr3 = main_tss[0].cr3;
+    
+    fault->eip = (uint32_t)page_fault_task;
+    fault->esp = (uint32_t)&fault_stack[cpu][FAULT_STACK_SIZE];
+    fault->eflags = 0x00000002;  // Reserved bit only: interrupts stay off
+    fault->cs = GDT_KERNEL_CODE;
+    fault->ss = fault->ds = fault->es = fault->fs = GDT_KERNEL_DATA;
+    fault->gs = GDT_PERCPU;
+    fault->cr3 = main->cr3;
+    fault->iomap_base = sizeof(tss_t);
+    
+    gdt_set_entry(table, 0, 0, 0, 0, 0);                      // Null descriptor
+    gdt_set_entry(table, 1, 0, 0xFFFFF, 0x9A, 0xC0);          // Kernel code
+    gdt_set_entry(table, 2, 0, 0xFFFFF, 0x92, 0xC0);          // Kernel data
+    gdt_set_entry(table, 3, (uint32_t)main, sizeof(tss_t) - 1, 0x89, 0x00);
+    gdt_set_entry(table, 4, (uint32_t)fault, sizeof(tss_t) - 1, 0x89, 0x00);
+    gdt_set_entry(table, 5, (uint32_t)percpu, sizeof(cpu_t) - 1, 0x92, 0x40);
+    
+    gdt_ptr[cpu].limit = sizeof(gdt[cpu]) - 1;
+    gdt_ptr[cpu].base = (uint32_t)table;
+    
+    percpu->self = percpu;
+    percpu->id = cpu;
+}
+
+// Load the tables of `cpu` on the calling CPU
+void gdt_load_cpu(int cpu) {
+    __asm__ volatile (
+        "lgdt %0\n"
+        "ljmp %1, $1f\n"
+        "1:\n"
+        "mov %2, %%ax\n"
+        "mov %%ax, %%ds\n"
+        "mov %%ax, %%es\n"
+        "mov %%ax, %%fs\n"
+        "mov %%ax, %%ss\n"
+        "mov %3, %%ax\n"
+        "mov %%ax, %%gs\n"
+        "mov %4, %%ax\n"
+        "ltr %%ax\n"
+        : : "m"(gdt_ptr[cpu]), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA),
+            "i"(GDT_PERCPU), "i"(GDT_TSS_MAIN)
+        : "eax", "memory");
+}
+
+// lgdt operand of `cpu`, for the AP start-up trampoline
+void gdt_get_pointer(int cpu, uint16_t* limit, uint32_t* base) {
+    *limit = gdt_ptr[cpu].limit;
+    *base = gdt_ptr[cpu].base;
+}
+
+// A task switch reloads CR3 from the incoming TSS, so both tasks must name
+// the kernel page directory
+void gdt_set_cr3(uint32_t cr3) {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        main_tss[i].cr3 = cr3;
+        fault_tss[i].cr3 = cr3;
+    }
+}
+
+// Main TSS of the calling CPU; holds the interrupted state during a page fault
+tss_t* gdt_main_tss(void) {
+    return &main_tss[this_cpu()->id];
+}
@@ -0,0 +1,38 @@
+/* gdt.h - Per-CPU global descriptor tables and task state segments */
+#ifndef GDT_H
+#define GDT_H
+
+#include "types.h"
+
+// Segment selectors
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_TSS_MAIN    0x18  // Task the kernel and all processes run in
+#define GDT_TSS_FAULT   0x20  // Task that services page faults
+#define GDT_PERCPU      0x28  // Data segment based at the CPU's cpu_t (GS)
+
+// 32-bit task state segment
+typedef struct {
+    uint32_t prev_task;
+    uint32_t esp0, ss0;
+    uint32_t esp1, ss1;
+    uint32_t esp2, ss2;
+    uint32_t cr3;
+    uint32_t eip;
+    uint32_t eflags;
+    uint32_t eax, ecx, edx, ebx;
+    uint32_t esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+void gdt_init(void);
+void gdt_setup_cpu(int cpu);
+void gdt_load_cpu(int cpu);
+void gdt_get_pointer(int cpu, uint16_t* limit, uint32_t* base);
+void gdt_set_cr3(uint32_t cr3);
+tss_t* gdt_main_tss(void);
+
+#endif
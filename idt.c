@@ -0,0 +1,125 @@
+/* idt.c - Interrupt descriptor table, exception and IRQ dispatch */
+#include "idt.h"
+#include "gdt.h"
+#include "pic.h"
+#include "log.h"
+#include "io.h"
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+static idt_entry_t idt[IDT_ENTRIES];
+static idt_ptr_t idt_ptr;
+static interrupt_handler_t handlers[IDT_ENTRIES];
+
+extern uint32_t isr_stub_table[EXCEPTION_COUNT + IRQ_COUNT];  // isr.S
+
+static const char* exception_names[EXCEPTION_COUNT] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "Bound range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS",
+    "Segment not present", "Stack-segment fault", "General protection fault",
+    "Page fault", "Reserved", "x87 floating-point error", "Alignment check",
+    "Machine check", "SIMD floating-point error", "Virtualization",
+    "Control protection", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Hypervisor injection", "VMM communication",
+    "Security", "Reserved"
+};
+
+// 32-bit interrupt gate (interrupts disabled on entry)
+void idt_set_gate(uint8_t vector, uint32_t handler) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = GDT_KERNEL_CODE;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = 0x8E;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+// Task gate: the CPU switches to the task named by `tss_selector`
+void idt_set_task_gate(uint8_t vector, uint16_t tss_selector) {
+    idt[vector].offset_low = 0;
+    idt[vector].selector = tss_selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = 0x85;
+    idt[vector].offset_high = 0;
+}
+
+void register_interrupt_handler(uint8_t vector, interrupt_handler_t handler) {
+    handlers[vector] = handler;
+}
+
+void register_irq_handler(uint8_t irq, interrupt_handler_t handler) {
+    handlers[IRQ_BASE + irq] = handler;
+}
+
+// Install exception and IRQ gates. The PIC is remapped here but leaves
+// every line masked until a driver unmasks its own.
+void idt_init(void) {
+    memset(idt, 0, sizeof(idt));
+    memset(handlers, 0, sizeof(handlers));
+    
+    for (int i = 0; i < EXCEPTION_COUNT + IRQ_COUNT; i++) {
+        idt_set_gate((uint8_t)i, isr_stub_table[i]);
+    }
+    idt_set_task_gate(VECTOR_PAGE_FAULT, GDT_TSS_FAULT);
+    
+    pic_init(IRQ_BASE, IRQ_BASE + 8);
+    
+    idt_ptr.limit = sizeof(idt) - 1;
+    idt_ptr.base = (uint32_t)&idt;
+    idt_load();
+}
+
+// All CPUs share the one table
+void idt_load(void) {
+    __asm__ volatile ("lidt %0" : : "m"(idt_ptr));
+}
+
+void panic(const char* message) {
+    __asm__ volatile ("cli");
+    serial_panic();
+    log_drain();  // Whatever was logged before the panic
+    printf_serial("\nKERNEL PANIC: %s\n", message);
+    for (;;) {
+        __asm__ volatile ("hlt");
+    }
+}
+
+// Called from the common stub in isr.S for every vector
+void isr_handler(interrupt_frame_t* frame) {
+    if (frame->vector >= IRQ_BASE && frame->vector < IRQ_BASE + IRQ_COUNT) {
+        uint8_t irq = (uint8_t)(frame->vector - IRQ_BASE);
+        if (pic_is_spurious(irq)) return;
+        // Acknowledge first: the timer handler may switch to another
+        // process and not come back here for a whole quantum
+        pic_send_eoi(irq);
+        if (handlers[frame->vector]) {
+            handlers[frame->vector](frame);
+        }
+        return;
+    }
+    
+    if (handlers[frame->vector]) {
+        handlers[frame->vector](frame);
+        return;
+    }
+    
+    if (frame->vector < EXCEPTION_COUNT) {
+        printf_serial("\nException %u (%s) at EIP 0x%x, error code 0x%x\n",
+                      frame->vector, exception_names[frame->vector],
+                      frame->eip, frame->error_code);
+        panic("Unhandled exception");
+    }
+    
+    printf_serial("Unhandled interrupt %u\n", frame->vector);
+}
@@ -0,0 +1,35 @@
+/* idt.h - Interrupt descriptor table, exception and IRQ dispatch */
+#ifndef IDT_H
+#define IDT_H
+
+#include "types.h"
+
+#define IDT_ENTRIES      256
+#define EXCEPTION_COUNT  32
+#define VECTOR_PAGE_FAULT 14
+
+// Hardware IRQs, remapped by the PIC to sit right after the exceptions
+#define IRQ_BASE         32
+#define IRQ_COUNT        16
+#define IRQ_TIMER        0
+#define IRQ_COM1         4
+
+// Register state pushed by the common interrupt stub
+typedef struct {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;  // pusha
+    uint32_t vector, error_code;
+    uint32_t eip, cs, eflags;                         // Pushed by the CPU
+} interrupt_frame_t;
+
+typedef void (*interrupt_handler_t)(interrupt_frame_t* frame);
+
+void idt_init(void);
+void idt_load(void);
+void idt_set_gate(uint8_t vector, uint32_t handler);
+void idt_set_task_gate(uint8_t vector, uint16_t tss_selector);
+void register_interrupt_handler(uint8_t vector, interrupt_handler_t handler);
+void register_irq_handler(uint8_t irq, interrupt_handler_t handler);
+void panic(const char* message);
+
+#endif
@@ -1,142 +1,425 @@
-/* io.c - I/O utility functions and serial communication */
-#include "io.h"
-
-#define COM1 0x3F8   /* I/O port base address for COM1 */
-
-// Serial port driver
-void serial_init(void) {
-    outb(COM1 + 1, 0x00);    /* Disable interrupts */
-    outb(COM1 + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
-    outb(COM1 + 0, 0x03);    /* Divisor low byte (38400 baud) */
-    outb(COM1 + 1, 0x00);    /* Divisor high byte */
-    outb(COM1 + 3, 0x03);    /* 8 bits, no parity, 1 stop bit */
-    outb(COM1 + 2, 0xC7);    /* Enable FIFO, clear, 14-byte threshold */
-    outb(COM1 + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
-}
-
-static int is_transmit_empty(void) {
-    return inb(COM1 + 5) & 0x20;
-}
-
-void serial_putc(char c) {
-    if (c == '\n') {
-        serial_putc('\r');  /* Add carriage return */
-    }
-    while (!is_transmit_empty());
-    outb(COM1, c);
-}
-
-void serial_puts(const char* str) {
-    while (*str) {
-        serial_putc(*str++);
-    }
-}
-
-static int serial_received(void) {
-    return inb(COM1 + 5) & 0x01;
-}
-
-char serial_getc(void) {
-    while (!serial_received());
-    return inb(COM1);
-}
-
-// Simple itoa function for integers
-static void itoa(int num, char* str, int base) {
-    int i = 0;
-    int isNegative = 0;
-    
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return;
-    }
-    
-    if (num < 0 && base == 10) {
-        isNegative = 1;
-        num = -num;
-    }
-    
-    while (num != 0) {
-        int rem = num % base;
-        str[i++] = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
-        num = num / base;
-    }
-    
-    if (isNegative)
-        str[i++] = '-';
-    
-    str[i] = '\0';
-    
-    // Reverse string
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
-    }
-}
-
-// Simple printf for serial output (supports %d, %u, %x, %s, %c)
-void printf_serial(const char* format, ...) {
-    char** arg = (char**)&format;
-    arg++;  // Point to first argument after format
-    
-    char c;
-    char buf[20];
-    
-    while ((c = *format++)) {
-        if (c != '%') {
-            serial_putc(c);
-        } else {
-            c = *format++;
-            switch (c) {
-                case 'd':
-                case 'i': {
-                    int val = *((int*)arg);
-                    arg++;
-                    itoa(val, buf, 10);
-                    serial_puts(buf);
-                    break;
-                }
-                case 'u': {
-                    unsigned int val = *((unsigned int*)arg);
-                    arg++;
-                    itoa(val, buf, 10);
-                    serial_puts(buf);
-                    break;
-                }
-                case 'x': {
-                    unsigned int val = *((unsigned int*)arg);
-                    arg++;
-                    itoa(val, buf, 16);
-                    serial_puts(buf);
-                    break;
-                }
-                case 's': {
-                    char* str = *((char**)arg);
-                    arg++;
-                    serial_puts(str);
-                    break;
-                }
-                case 'c': {
-                    char ch = *((char*)arg);
-                    arg++;
-                    serial_putc(ch);
-                    break;
-                }
-                case '%': {
-                    serial_putc('%');
-                    break;
-                }
-                default:
-                    serial_putc('%');
-                    serial_putc(c);
-                    break;
-            }
-        }
-    }
-}
+/* io.c - I/O utility functions and serial communication */
+#include "io.h"
+#include "idt.h"
+#include "pic.h"
+#include "sync.h"
+
+#define COM1 0x3F8   /* I/O port base address for COM1 */
+#define COM1_IER (COM1 + 1)
+#define COM1_IIR (COM1 + 2)
+#define COM1_LSR (COM1 + 5)
+
+#define UART_IER_RDA   0x01   /* Interrupt when received data is available */
+#define UART_IER_THRE  0x02   /* Interrupt when the transmit FIFO empties */
+#define UART_LSR_DR    0x01
+#define UART_LSR_OE    0x02
+#define UART_LSR_THRE  0x20
+#define UART_FIFO_SIZE 16
+
+// Transmit ring; head and tail run free and are masked on use
+static char tx_ring[SERIAL_TX_RING_SIZE];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static int tx_irq = 0;         // Ring in use: serial_enable_irq ran, no panic since
+static int tx_full = 0;        // Dropping since the last byte that fit
+static uint8_t uart_ier = 0;   // Shadow of COM1_IER
+
+// Receive ring, CR and CR LF folded into a single LF
+static char rx_ring[SERIAL_RX_RING_SIZE];
+static uint32_t rx_head = 0;
+static uint32_t rx_tail = 0;
+static uint32_t rx_lines = 0;        // LFs in the ring
+static char rx_last = 0;             // Last byte from the UART, before folding
+static int rx_irq = 0;               // Ring in use: serial_enable_irq ran
+static wait_queue_t rx_waiters;      // serial_read: any input
+static wait_queue_t line_waiters;    // serial_readline: a whole line
+
+static uint32_t uart_interrupts = 0;
+static uint32_t tx_bytes = 0;
+static uint32_t tx_drops = 0;
+static uint32_t tx_overruns = 0;
+static uint32_t tx_peak = 0;
+static uint32_t tx_stalls = 0;       // Bytes serial_write pushed out itself
+static uint32_t rx_bytes = 0;
+static uint32_t rx_drops = 0;
+static uint32_t rx_uart_overruns = 0; // Lost in the UART before the handler ran
+static uint32_t rx_sleeps = 0;
+
+// Serial port driver
+void serial_init(void) {
+    outb(COM1 + 1, 0x00);    /* Disable interrupts */
+    outb(COM1 + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
+    outb(COM1 + 0, 0x03);    /* Divisor low byte (38400 baud) */
+    outb(COM1 + 1, 0x00);    /* Divisor high byte */
+    outb(COM1 + 3, 0x03);    /* 8 bits, no parity, 1 stop bit */
+    outb(COM1 + 2, 0xC7);    /* Enable FIFO, clear, 14-byte threshold */
+    outb(COM1 + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
+}
+
+static int is_transmit_empty(void) {
+    return inb(COM1_LSR) & UART_LSR_THRE;
+}
+
+static void tx_poll(char c) {
+    while (!is_transmit_empty());
+    outb(COM1, c);
+}
+
+// Refill the UART FIFO from the ring once it has drained, and keep the
+// transmit interrupt armed only while bytes are left. Called under irq_save.
+static void tx_kick(void) {
+    if (is_transmit_empty()) {
+        for (int n = 0; n < UART_FIFO_SIZE && tx_tail != tx_head; n++) {
+            outb(COM1, tx_ring[tx_tail++ & (SERIAL_TX_RING_SIZE - 1)]);
+        }
+    }
+    uint8_t ier = (tx_tail != tx_head) ? (uart_ier | UART_IER_THRE)
+                                       : (uart_ier & ~UART_IER_THRE);
+    if (ier != uart_ier) {
+        uart_ier = ier;
+        outb(COM1_IER, ier);
+    }
+}
+
+static void tx_put(char c) {
+    uint32_t used = tx_head - tx_tail;
+    if (used == SERIAL_TX_RING_SIZE) {
+        tx_drops++;
+        if (!tx_full) {
+            tx_full = 1;
+            tx_overruns++;
+        }
+        return;
+    }
+    tx_full = 0;
+    tx_ring[tx_head++ & (SERIAL_TX_RING_SIZE - 1)] = c;
+    tx_bytes++;
+    if (used + 1 > tx_peak) tx_peak = used + 1;
+}
+
+// One character of output, CR added before LF. Callers kick the ring once
+// per call rather than once per byte: every port access is slow.
+static void serial_emit(char c) {
+    if (!tx_irq) {
+        if (c == '\n') tx_poll('\r');
+        tx_poll(c);
+        return;
+    }
+    if (c == '\n') tx_put('\r');
+    tx_put(c);
+}
+
+static void serial_emit_str(const char* str) {
+    while (*str) {
+        serial_emit(*str++);
+    }
+}
+
+// Move everything the UART holds into the ring, then wake readers once for
+// the whole batch: line readers only when a line is complete or the ring
+// is full. Called under irq_save.
+static void rx_drain(void) {
+    int got = 0;
+    int lines = 0;
+    uint8_t lsr;
+    while ((lsr = inb(COM1_LSR)) & UART_LSR_DR) {
+        if (lsr & UART_LSR_OE) rx_uart_overruns++;
+        char c = (char)inb(COM1);
+        char last = rx_last;
+        rx_last = c;
+        if (c == '\n' && last == '\r') continue;
+        if (c == '\r') c = '\n';
+        
+        if (rx_head - rx_tail == SERIAL_RX_RING_SIZE) {
+            rx_drops++;
+            continue;
+        }
+        rx_ring[rx_head++ & (SERIAL_RX_RING_SIZE - 1)] = c;
+        rx_bytes++;
+        got = 1;
+        if (c == '\n') {
+            rx_lines++;
+            lines = 1;
+        }
+    }
+    
+    if (got) wait_queue_wake_all(&rx_waiters);
+    if (lines || rx_head - rx_tail == SERIAL_RX_RING_SIZE) {
+        wait_queue_wake_all(&line_waiters);
+    }
+}
+
+static void serial_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    uint32_t irq = irq_save();
+    inb(COM1_IIR);          // Acknowledges a transmit interrupt; receive ones clear as data is read
+    uart_interrupts++;
+    rx_drain();
+    tx_kick();
+    irq_restore(irq);
+}
+
+// Switch output and input to the rings. Needs the IDT and PIC set up; until
+// then (and for anything that cannot wait for interrupts) output stays
+// synchronous and input is polled.
+void serial_enable_irq(void) {
+    wait_queue_init(&rx_waiters);
+    wait_queue_init(&line_waiters);
+    register_irq_handler(IRQ_COM1, serial_irq);
+    
+    uint32_t irq = irq_save();
+    tx_irq = 1;
+    rx_irq = 1;
+    uart_ier |= UART_IER_RDA;
+    outb(COM1_IER, uart_ier);
+    irq_restore(irq);
+    pic_unmask(IRQ_COM1);
+}
+
+// Back to synchronous output for good, after writing out whatever is still
+// queued. For panics: takes no lock and never waits for an interrupt.
+void serial_panic(void) {
+    tx_irq = 0;
+    uart_ier = 0;
+    outb(COM1_IER, 0);
+    while (tx_tail != tx_head) {
+        char c = tx_ring[tx_tail++ & (SERIAL_TX_RING_SIZE - 1)];
+        tx_poll(c);
+    }
+}
+
+void serial_putc(char c) {
+    uint32_t irq = irq_save();
+    serial_emit(c);
+    if (tx_irq) tx_kick();
+    irq_restore(irq);
+}
+
+void serial_puts(const char* str) {
+    uint32_t irq = irq_save();
+    serial_emit_str(str);
+    if (tx_irq) tx_kick();
+    irq_restore(irq);
+}
+
+static int serial_received(void) {
+    return inb(COM1_LSR) & UART_LSR_DR;
+}
+
+static char rx_poll(void) {
+    while (!serial_received());
+    return inb(COM1);
+}
+
+static char rx_take(void) {
+    char c = rx_ring[rx_tail++ & (SERIAL_RX_RING_SIZE - 1)];
+    if (c == '\n') rx_lines--;
+    return c;
+}
+
+// Sleep on `queue` until the receive interrupt wakes it. The idle process
+// cannot sleep, so it halts until the next interrupt instead.
+static void rx_wait(wait_queue_t* queue, uint32_t* irq) {
+    rx_sleeps++;
+    if (!wait_queue_sleep(queue, WAIT_INPUT)) {
+        irq_restore(*irq);
+        __asm__ volatile ("hlt");
+        *irq = irq_save();
+    }
+}
+
+// Read whatever input is buffered, up to `len` bytes, blocking only while
+// there is none. Returns the number of bytes read.
+int serial_read(char* buf, int len) {
+    if (len <= 0) return 0;
+    if (!rx_irq) {
+        buf[0] = rx_poll();
+        return 1;
+    }
+    
+    uint32_t irq = irq_save();
+    while (rx_head == rx_tail) {
+        rx_wait(&rx_waiters, &irq);
+    }
+    int n = 0;
+    while (n < len && rx_tail != rx_head) {
+        buf[n++] = rx_take();
+    }
+    irq_restore(irq);
+    return n;
+}
+
+// Read one line, LF included, into `buf` and NUL-terminate it. Blocks until
+// a whole line has arrived or there is enough to fill `buf`, so the reader
+// wakes once per line rather than once per keystroke. Returns the length.
+int serial_readline(char* buf, int len) {
+    if (len <= 0) return 0;
+    int n = 0;
+    if (!rx_irq) {
+        while (n < len - 1) {
+            char c = rx_poll();
+            if (c == '\r') c = '\n';
+            buf[n++] = c;
+            if (c == '\n') break;
+        }
+        buf[n] = '\0';
+        return n;
+    }
+    
+    uint32_t want = (uint32_t)(len - 1);
+    uint32_t irq = irq_save();
+    while (!rx_lines && rx_head - rx_tail < want && rx_head - rx_tail < SERIAL_RX_RING_SIZE) {
+        rx_wait(&line_waiters, &irq);
+    }
+    while ((uint32_t)n < want && rx_tail != rx_head) {
+        char c = rx_take();
+        buf[n++] = c;
+        if (c == '\n') break;
+    }
+    irq_restore(irq);
+    buf[n] = '\0';
+    return n;
+}
+
+char serial_getc(void) {
+    char c;
+    serial_read(&c, 1);
+    return c;
+}
+
+// Raw bytes, no CR added: binary frames such as the deferred log's. A
+// frame with a hole in it is useless, so instead of dropping when the ring
+// is full this writes the oldest queued byte out itself to make room.
+void serial_write(const void* buf, int len) {
+    const char* p = (const char*)buf;
+    uint32_t irq = irq_save();
+    for (int i = 0; i < len; i++) {
+        if (!tx_irq) {
+            tx_poll(p[i]);
+            continue;
+        }
+        if (tx_head - tx_tail == SERIAL_TX_RING_SIZE) {
+            tx_poll(tx_ring[tx_tail++ & (SERIAL_TX_RING_SIZE - 1)]);
+            tx_stalls++;
+        }
+        tx_put(p[i]);
+    }
+    if (tx_irq) tx_kick();
+    irq_restore(irq);
+}
+
+void serial_stats(void) {
+    uint32_t irq = irq_save();
+    uint32_t tx_queued = tx_head - tx_tail;
+    uint32_t rx_queued = rx_head - rx_tail;
+    irq_restore(irq);
+    printf_serial("Serial: %u interrupts\n", uart_interrupts);
+    printf_serial("Serial TX: %u bytes, %u queued (peak %u of %u), %u dropped in %u overruns, %u stalls\n",
+                  tx_bytes, tx_queued, tx_peak, SERIAL_TX_RING_SIZE, tx_drops, tx_overruns, tx_stalls);
+    printf_serial("Serial RX: %u bytes, %u queued, %u dropped, %u lost in the UART, %u reader sleeps\n",
+                  rx_bytes, rx_queued, rx_drops, rx_uart_overruns, rx_sleeps);
+}
+
+// Simple itoa function for integers
+static void itoa(int num, char* str, int base) {
+    int i = 0;
+    int isNegative = 0;
+    
+    if (num == 0) {
+        str[i++] = '0';
+        str[i] = '\0';
+        return;
+    }
+    
+    if (num < 0 && base == 10) {
+        isNegative = 1;
+        num = -num;
+    }
+    
+    while (num != 0) {
+        int rem = num % base;
+        str[i++] = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
+        num = num / base;
+    }
+    
+    if (isNegative)
+        str[i++] = '-';
+    
+    str[i] = '\0';
+    
+    // Reverse string
+    int start = 0;
+    int end = i - 1;
+    while (start < end) {
+        char temp = str[start];
+        str[start] = str[end];
+        str[end] = temp;
+        start++;
+        end--;
+    }
+}
+
+// Simple printf for serial output (supports %d, %u, %x, %s, %c). One call
+// is one critical section, so lines from different CPUs do not interleave.
+void printf_serial(const char* format, ...) {
+    char** arg = (char**)&format;
+    arg++;  // Point to first argument after format
+    
+    char c;
+    char buf[20];
+    uint32_t irq = irq_save();
+    
+    while ((c = *format++)) {
+        if (c != '%') {
+            serial_emit(c);
+        } else {
+            c = *format++;
+            switch (c) {
+                case 'd':
+                case 'i': {
+                    int val = *((int*)arg);
+                    arg++;
+                    itoa(val, buf, 10);
+                    serial_emit_str(buf);
+                    break;
+                }
+                case 'u': {
+                    unsigned int val = *((unsigned int*)arg);
+                    arg++;
+                    itoa(val, buf, 10);
+                    serial_emit_str(buf);
+                    break;
+                }
+                case 'x': {
+                    unsigned int val = *((unsigned int*)arg);
+                    arg++;
+                    itoa(val, buf, 16);
+                    serial_emit_str(buf);
+                    break;
+                }
+                case 's': {
+                    char* str = *((char**)arg);
+                    arg++;
+                    serial_emit_str(str);
+                    break;
+                }
+                case 'c': {
+                    char ch = *((char*)arg);
+                    arg++;
+                    serial_emit(ch);
+                    break;
+                }
+                case '%': {
+                    serial_emit('%');
+                    break;
+                }
+                default:
+                    serial_emit('%');
+                    serial_emit(c);
+                    break;
+            }
+        }
+    }
+    if (tx_irq) tx_kick();
+    irq_restore(irq);
+}
@@ -1,27 +1,86 @@
-/* io.h - I/O operations and serial communication */
-#ifndef IO_H
-#define IO_H
-
-#include "types.h"
-
-// Low-level port I/O
-static inline void outb(uint16_t port, uint8_t val) {
-    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
-}
-
-static inline uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
-
-// Serial port functions
-void serial_init(void);
-void serial_putc(char c);
-void serial_puts(const char* str);
-char serial_getc(void);
-
-// Printf-like function for serial output
-void printf_serial(const char* format, ...);
-
-#endif
+/* io.h - I/O operations and serial communication */
+#ifndef IO_H
+#define IO_H
+
+#include "types.h"
+
+// Low-level port I/O
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+extern volatile int smp_active;  // smp.c: set once a second CPU may run
+
+// Mask interrupts on this CPU and return the previous EFLAGS; pair with
+// local_irq_restore. Enough for state only this CPU touches (SSE registers).
+// Host builds of kernel code run in user mode, where these are no-ops.
+#ifndef KACCHI_HOST
+static inline uint32_t local_irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf\n pop %0\n cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint32_t flags) {
+    __asm__ volatile ("push %0\n popf" : : "r"(flags) : "memory", "cc");
+}
+
+// Kernel critical section; pair with irq_restore. Once other CPUs are
+// online (smp.c) this also takes the big kernel lock, so it still means
+// nothing else touches kernel state until irq_restore.
+void kernel_lock(void);
+void kernel_unlock(void);
+
+static inline uint32_t irq_save(void) {
+    uint32_t flags = local_irq_save();
+    if (smp_active) kernel_lock();
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (smp_active) kernel_unlock();
+    local_irq_restore(flags);
+}
+#else
+static inline uint32_t local_irq_save(void) { return 0; }
+static inline void local_irq_restore(uint32_t flags) { (void)flags; }
+static inline uint32_t irq_save(void) { return 0; }
+static inline void irq_restore(uint32_t flags) { (void)flags; }
+#endif
+
+// Time-stamp counter
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Serial port functions. Output is written synchronously until
+// serial_enable_irq; from then on it goes through a ring drained by the
+// UART's transmit interrupt, and a full ring drops bytes rather than stall.
+// Input likewise lands in a ring filled by the receive interrupt, and
+// readers sleep until it has what they asked for.
+#define SERIAL_TX_RING_SIZE 8192   // Power of two
+#define SERIAL_RX_RING_SIZE 1024   // Power of two
+
+void serial_init(void);
+void serial_enable_irq(void);
+void serial_panic(void);
+void serial_putc(char c);
+void serial_puts(const char* str);
+void serial_write(const void* buf, int len);
+char serial_getc(void);
+int serial_read(char* buf, int len);
+int serial_readline(char* buf, int len);
+void serial_stats(void);
+
+// Printf-like function for serial output
+void printf_serial(const char* format, ...);
+
+#endif
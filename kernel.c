@@ -1,144 +1,284 @@
-/* kernel.c - Main kernel integrating all components */
-#include "types.h"
-#include "io.h"
-#include "memory.h"
-#include "process.h"
-#include "scheduler.h"
-
-// Test process functions
-void process1(void) {
-    printf_serial("Process 1 starting (PID: %d)\n", get_current_pid());
-    int count = 0;
-    while(count < 5) {
-        printf_serial("  [P1] Iteration %d\n", count++);
-        // Simulate some work
-        for (volatile int i = 0; i < 100000; i++);
-    }
-    printf_serial("Process 1 completed\n");
-    terminate_process(get_current_pid());
-}
-
-void process2(void) {
-    printf_serial("Process 2 starting (PID: %d)\n", get_current_pid());
-    int count = 0;
-    while(count < 5) {
-        printf_serial("  [P2] Iteration %d\n", count++);
-        // Simulate some work
-        for (volatile int i = 0; i < 100000; i++);
-    }
-    printf_serial("Process 2 completed\n");
-    terminate_process(get_current_pid());
-}
-
-void process3(void) {
-    printf_serial("Process 3 starting (PID: %d)\n", get_current_pid());
-    int count = 0;
-    while(count < 5) {
-        printf_serial("  [P3] Iteration %d\n", count++);
-        // Simulate some work
-        for (volatile int i = 0; i < 100000; i++);
-    }
-    printf_serial("Process 3 completed\n");
-    terminate_process(get_current_pid());
-}
-
-void kmain(void) {
-    /* Initialize hardware */
-    serial_init();
-    
-    /* Print welcome banner */
-    serial_puts("\n");
-    serial_puts("========================================\n");
-    serial_puts("    kacchiOS - Extended Version\n");
-    serial_puts("========================================\n");
-    serial_puts("CSE 3202 Operating Systems Project\n");
-    serial_puts("Features: Memory, Process, Scheduler\n");
-    serial_puts("========================================\n\n");
-    
-    // Initialize all OS components
-    serial_puts("[INIT] Initializing Memory Manager...\n");
-    memory_init();
-    
-    serial_puts("[INIT] Initializing Process Manager...\n");
-    process_manager_init();
-    
-    serial_puts("[INIT] Initializing Scheduler...\n");
-    scheduler_init(SCHED_ROUND_ROBIN, 100);
-    
-    serial_puts("\n[KERNEL] Creating test processes...\n");
-    
-    // Create test processes
-    int pid1 = create_process(process1, "TestProc1");
-    int pid2 = create_process(process2, "TestProc2");
-    int pid3 = create_process(process3, "TestProc3");
-    
-    if (pid1 > 0) {
-        printf_serial("[KERNEL] Created process PID=%d\n", pid1);
-        pcb_t* p1 = get_process(pid1);
-        if (p1) add_to_ready_queue(p1);
-    }
-    
-    if (pid2 > 0) {
-        printf_serial("[KERNEL] Created process PID=%d\n", pid2);
-        pcb_t* p2 = get_process(pid2);
-        if (p2) add_to_ready_queue(p2);
-    }
-    
-    if (pid3 > 0) {
-        printf_serial("[KERNEL] Created process PID=%d\n", pid3);
-        pcb_t* p3 = get_process(pid3);
-        if (p3) add_to_ready_queue(p3);
-    }
-    
-    serial_puts("\n[KERNEL] Starting scheduler...\n");
-    serial_puts("========================================\n\n");
-    
-    // Simplified scheduling demonstration
-    // In a real OS, this would be interrupt-driven
-    serial_puts("[NOTE] This is a simplified scheduler demonstration\n");
-    serial_puts("[NOTE] In a real OS, context switches would be interrupt-driven\n\n");
-    
-    int tick_counter = 0;
-    int max_ticks = 500;  // Run for limited time in demo
-    
-    while(tick_counter < max_ticks) {
-        // Simulate timer tick
-        timer_tick();
-        
-        // Perform scheduling
-        schedule();
-        
-        // Display stats periodically
-        if (tick_counter % 100 == 0 && tick_counter > 0) {
-            printf_serial("\n========================================\n");
-            printf_serial("=== System Status (Tick %d) ===\n", tick_counter);
-            printf_serial("========================================\n");
-            memory_stats();
-            serial_puts("\n");
-            list_processes();
-            serial_puts("\n");
-            scheduler_stats();
-            serial_puts("========================================\n\n");
-        }
-        
-        tick_counter++;
-    }
-    
-    serial_puts("\n========================================\n");
-    serial_puts("=== Final System Statistics ===\n");
-    serial_puts("========================================\n");
-    memory_stats();
-    serial_puts("\n");
-    list_processes();
-    serial_puts("\n");
-    scheduler_stats();
-    serial_puts("========================================\n");
-    
-    serial_puts("\n[KERNEL] Demonstration completed.\n");
-    serial_puts("Thank you for using kacchiOS!\n\n");
-    
-    /* Halt system */
-    for (;;) {
-        __asm__ volatile ("hlt");
-    }
-}
+/* kernel.c - Main kernel integrating all components */
+#include "types.h"
+#include "io.h"
+#include "memops.h"
+#include "multiboot.h"
+#include "gdt.h"
+#include "idt.h"
+#include "pit.h"
+#include "page.h"
+#include "paging.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "sync.h"
+#include "log.h"
+#include "trace.h"
+
+// Shared by the test processes
+static mutex_t demo_lock;
+static int demo_total = 0;
+
+// Test process functions
+void process1(void) {
+    printf_serial("Process 1 starting (PID: %d)\n", get_current_pid());
+    int count = 0;
+    while(count < 5) {
+        mutex_lock(&demo_lock);
+        printf_serial("  [P1] Iteration %d (total %d)\n", count++, ++demo_total);
+        mutex_unlock(&demo_lock);
+        // Simulate some work
+        for (volatile int i = 0; i < 100000; i++);
+    }
+    printf_serial("Process 1 completed\n");
+    terminate_process(get_current_pid());
+}
+
+void process2(void) {
+    printf_serial("Process 2 starting (PID: %d)\n", get_current_pid());
+    int count = 0;
+    while(count < 5) {
+        mutex_lock(&demo_lock);
+        printf_serial("  [P2] Iteration %d (total %d)\n", count++, ++demo_total);
+        mutex_unlock(&demo_lock);
+        // Simulate some work
+        for (volatile int i = 0; i < 100000; i++);
+    }
+    printf_serial("Process 2 completed\n");
+    terminate_process(get_current_pid());
+}
+
+void process3(void) {
+    printf_serial("Process 3 starting (PID: %d)\n", get_current_pid());
+    int count = 0;
+    while(count < 5) {
+        mutex_lock(&demo_lock);
+        printf_serial("  [P3] Iteration %d (total %d)\n", count++, ++demo_total);
+        mutex_unlock(&demo_lock);
+        // Simulate some work
+        for (volatile int i = 0; i < 100000; i++);
+    }
+    printf_serial("Process 3 completed\n");
+    terminate_process(get_current_pid());
+}
+
+#ifdef MAILBOX_CHECK
+// Fills its own mailbox with copied (out-of-line) payloads and drains it,
+// over and over. Once everything is released the arena has to rewind, so
+// its size must not grow after the first round.
+#define MAILBOX_CHECK_ROUNDS 500
+
+void mailbox_check_process(void) {
+    pcb_t* self = get_current_process();
+    uint8_t payload[MAILBOX_INLINE_SIZE * 2];
+    uint32_t pages = 0, peak = 0;
+    int failures = 0;
+    
+    for (int round = 0; round < MAILBOX_CHECK_ROUNDS; round++) {
+        for (uint32_t i = 0; i < self->mailbox.capacity; i++) {
+            memset(payload, (int)(round + i), sizeof(payload));
+            if (send_message(self->pid, payload, sizeof(payload)) < 0) failures++;
+        }
+        void* msg;
+        while ((msg = receive_message(NULL))) {
+            release_message(msg);
+        }
+        if (round == 0) {
+            pages = self->arena.pages;
+            peak = self->arena.peak_bytes;
+        }
+    }
+    
+    int bounded = self->arena.pages == pages && self->arena.peak_bytes == peak &&
+                  self->arena.bytes_used == 0;
+    printf_serial("[IPC] Mailbox reuse check: %s (%d rounds, %d failed sends, arena %u pages)\n",
+                  bounded && !failures ? "PASS" : "FAIL", MAILBOX_CHECK_ROUNDS, failures,
+                  self->arena.pages);
+}
+#endif
+
+// Echoes console input a line at a time, asleep in serial_readline between
+// lines instead of polling the UART
+void console_process(void) {
+    char line[80];
+    for (;;) {
+        int n = serial_readline(line, sizeof(line));
+        printf_serial("[console] %s%s", line, (n && line[n - 1] == '\n') ? "" : "\n");
+    }
+}
+
+void kmain(uint32_t magic, multiboot_info_t* mbi) {
+    /* Initialize hardware */
+    serial_init();
+    
+    /* Print welcome banner */
+    serial_puts("\n");
+    serial_puts("========================================\n");
+    serial_puts("    kacchiOS - Extended Version\n");
+    serial_puts("========================================\n");
+    serial_puts("CSE 3202 Operating Systems Project\n");
+    serial_puts("Features: Memory, Process, Scheduler\n");
+    serial_puts("========================================\n\n");
+    
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        printf_serial("[WARN] Not booted by a multiboot loader (magic 0x%x)\n", magic);
+        mbi = NULL;
+    }
+    
+    // Initialize all OS components
+    serial_puts("[INIT] Selecting memcpy/memset kernels...\n");
+    memops_init();
+    
+    serial_puts("[INIT] Initializing GDT, IDT and PIC...\n");
+    gdt_init();
+    idt_init();
+    log_init();
+    
+    serial_puts("[INIT] Initializing Page Allocator...\n");
+    page_init(mbi);
+    
+    serial_puts("[INIT] Enabling Paging...\n");
+    paging_init();
+    
+    serial_puts("[INIT] Initializing Memory Manager...\n");
+    memory_init();
+    
+    serial_puts("[INIT] Initializing Process Manager...\n");
+    process_manager_init();
+    
+    serial_puts("[INIT] Initializing Scheduler...\n");
+    scheduler_init(SCHED_ROUND_ROBIN, TIMER_HZ / 10);  // 100ms quantum
+    
+    // The PIT has to be running before the APs start: their start-up
+    // delays and LAPIC timer calibration count its ticks. Nothing is queued
+    // yet, so kmain keeps the CPU until the test processes are created.
+    pit_init(TIMER_HZ);
+    __asm__ volatile ("sti");
+    
+    // Interrupts are flowing: console output stops stalling the writer
+    serial_enable_irq();
+    
+    // Run, wait and block times are kept in TSC cycles from here on
+    tsc_calibrate();
+    
+    serial_puts("[INIT] Starting application processors...\n");
+    smp_init();
+    
+    serial_puts("\n[KERNEL] Creating test processes...\n");
+    trace_enable(1);
+    mutex_init(&demo_lock, "demo");
+    
+    // Create test processes
+    int pid1 = create_process(process1, "TestProc1");
+    int pid2 = create_process(process2, "TestProc2");
+    int pid3 = create_process(process3, "TestProc3");
+    int console_pid = create_process(console_process, "Console");
+    int log_pid = create_process(log_drain_process, "LogDrain");
+    
+    if (pid1 > 0) {
+        printf_serial("[KERNEL] Created process PID=%d\n", pid1);
+        pcb_t* p1 = get_process(pid1);
+        if (p1) add_to_ready_queue(p1);
+    }
+    
+    if (pid2 > 0) {
+        printf_serial("[KERNEL] Created process PID=%d\n", pid2);
+        pcb_t* p2 = get_process(pid2);
+        if (p2) add_to_ready_queue(p2);
+    }
+    
+    if (pid3 > 0) {
+        printf_serial("[KERNEL] Created process PID=%d\n", pid3);
+        pcb_t* p3 = get_process(pid3);
+        if (p3) add_to_ready_queue(p3);
+    }
+    
+    if (console_pid > 0) {
+        printf_serial("[KERNEL] Created console reader PID=%d\n", console_pid);
+        pcb_t* console = get_process(console_pid);
+        if (console) add_to_ready_queue(console);
+    }
+    
+#ifdef MAILBOX_CHECK
+    // Arena reuse check, not part of the demo (make run CHECK=1)
+    int check_pid = create_process(mailbox_check_process, "MboxCheck");
+    if (check_pid > 0) {
+        printf_serial("[KERNEL] Created mailbox check PID=%d\n", check_pid);
+        pcb_t* check = get_process(check_pid);
+        if (check) add_to_ready_queue(check);
+    }
+#endif
+    
+    if (log_pid > 0) {
+        printf_serial("[KERNEL] Created log drain PID=%d\n", log_pid);
+        pcb_t* drain = get_process(log_pid);
+        if (drain) {
+            drain->priority = 0;  // Lowest level under SCHED_PRIORITY; with any other
+                                  // policy log_drain_process defers to queued work itself
+            add_to_ready_queue(drain);
+        }
+    }
+    
+    serial_puts("\n[KERNEL] Starting scheduler...\n");
+    serial_puts("========================================\n\n");
+    
+    // From here on the timers drive timer_tick and preemption; kmain is
+    // the BSP's idle process and only runs when nothing else is ready
+    uint32_t max_ticks = 5 * TIMER_HZ;  // Run for limited time in demo
+    uint32_t next_status = TIMER_HZ;
+    
+    while (get_ticks() < max_ticks) {
+        __asm__ volatile ("hlt");
+        schedule();
+        
+        // Display stats periodically
+        if (get_ticks() >= next_status) {
+            next_status += TIMER_HZ;
+            printf_serial("\n========================================\n");
+            printf_serial("=== System Status (Tick %u) ===\n", get_ticks());
+            printf_serial("========================================\n");
+            memory_stats();
+            serial_puts("\n");
+            list_processes();
+            serial_puts("\n");
+            scheduler_stats();
+            serial_puts("\n");
+            sync_stats();
+            serial_stats();
+            log_stats();
+            trace_stats();
+            serial_puts("========================================\n\n");
+        }
+    }
+    
+    serial_puts("\n========================================\n");
+    serial_puts("=== Final System Statistics ===\n");
+    serial_puts("========================================\n");
+    memory_stats();
+    serial_puts("\n");
+    list_processes();
+    serial_puts("\n");
+    scheduler_stats();
+    serial_puts("\n");
+    sched_latency_stats();
+    serial_puts("\n");
+    sync_stats();
+    serial_stats();
+    log_stats();
+    trace_stats();
+    serial_puts("========================================\n");
+    
+#ifdef TRACE_DUMP
+    // Binary frame for tools/schedtrace.py (make run TRACE=1)
+    trace_dump();
+#endif
+    
+    serial_puts("\n[KERNEL] Demonstration completed.\n");
+    serial_puts("Thank you for using kacchiOS!\n\n");
+    
+    /* Halt system */
+    for (;;) {
+        __asm__ volatile ("hlt");
+    }
+}
@@ -0,0 +1,105 @@
+/* lapic.c - Local APIC: inter-processor interrupts and per-CPU timer */
+#include "lapic.h"
+#include "idt.h"
+#include "page.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "io.h"
+
+static volatile uint32_t* lapic = NULL;
+static uint32_t timer_count = 0;  // LAPIC timer counts per PIT tick, divide by 16
+
+extern void lapic_timer_isr(void);     // isr.S
+extern void lapic_spurious_isr(void);
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+    (void)lapic[LAPIC_ID / 4];  // Read back so the write has landed
+}
+
+static void lapic_timer_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    // Acknowledge first, as for the PIC: timer_tick may switch away
+    lapic_eoi();
+    timer_tick();
+}
+
+static void lapic_spurious_irq(interrupt_frame_t* frame) {
+    (void)frame;  // Never acknowledged
+}
+
+// Map the register page (uncached) and install the LAPIC vectors. Returns 0
+// if the CPU has no local APIC.
+int lapic_init(uintptr_t base) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    if (!((edx >> 9) & 1)) return 0;
+    
+    if (!paging_identity_map(base, PAGE_SIZE, PTE_WRITE | PTE_PCD)) return 0;
+    lapic = (volatile uint32_t*)base;
+    
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint32_t)lapic_timer_isr);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint32_t)lapic_spurious_isr);
+    register_interrupt_handler(LAPIC_TIMER_VECTOR, lapic_timer_irq);
+    register_interrupt_handler(LAPIC_SPURIOUS_VECTOR, lapic_spurious_irq);
+    
+    printf_serial("Local APIC at 0x%x\n", base);
+    return 1;
+}
+
+// Software-enable the calling CPU's LAPIC and accept every priority
+void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, 0x100 | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+uint8_t lapic_id(void) {
+    return (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Send `command` (delivery mode and vector) to the CPU with `apic_id` and
+// wait until the LAPIC has accepted it
+void lapic_send_ipi(uint8_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile ("pause");
+    }
+}
+
+// Count how far the LAPIC timer runs down in LAPIC_CALIBRATE_TICKS PIT
+// ticks, so every CPU can tick at the PIT's rate. Runs on the BSP with the
+// PIT going and interrupts enabled.
+void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIV, 0x3);          // Divide by 16
+    lapic_write(LAPIC_LVT_TIMER, 0x10000);      // Masked, one-shot
+    
+    uint32_t start = get_ticks();
+    while (get_ticks() == start) __asm__ volatile ("hlt");
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    start = get_ticks();
+    while (get_ticks() - start < LAPIC_CALIBRATE_TICKS) __asm__ volatile ("hlt");
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_COUNT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    
+    timer_count = elapsed / LAPIC_CALIBRATE_TICKS;
+    printf_serial("LAPIC timer: %u counts per tick\n", timer_count);
+}
+
+// Periodic LAPIC_TIMER_VECTOR interrupts at the calibrated tick rate
+void lapic_timer_start(void) {
+    if (!timer_count) return;
+    lapic_write(LAPIC_TIMER_DIV, 0x3);
+    lapic_write(LAPIC_LVT_TIMER, 0x20000 | LAPIC_TIMER_VECTOR);  // Periodic
+    lapic_write(LAPIC_TIMER_INIT, timer_count);
+}
@@ -0,0 +1,43 @@
+/* lapic.h - Local APIC: inter-processor interrupts and per-CPU timer */
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include "types.h"
+
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+// Register offsets
+#define LAPIC_ID        0x020
+#define LAPIC_TPR       0x080
+#define LAPIC_EOI       0x0B0
+#define LAPIC_SVR       0x0F0
+#define LAPIC_ESR       0x280
+#define LAPIC_ICR_LOW   0x300
+#define LAPIC_ICR_HIGH  0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_COUNT 0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+// Interrupt command register bits
+#define LAPIC_ICR_INIT     0x00000500
+#define LAPIC_ICR_STARTUP  0x00000600
+#define LAPIC_ICR_PENDING  0x00001000
+#define LAPIC_ICR_ASSERT   0x00004000
+#define LAPIC_ICR_LEVEL    0x00008000
+
+// Vectors above the PIC's IRQ range
+#define LAPIC_TIMER_VECTOR    48
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+#define LAPIC_CALIBRATE_TICKS 10  // PIT ticks the timer calibration runs for
+
+int lapic_init(uintptr_t base);
+void lapic_enable(void);
+uint8_t lapic_id(void);
+void lapic_eoi(void);
+void lapic_send_ipi(uint8_t apic_id, uint32_t command);
+void lapic_timer_calibrate(void);
+void lapic_timer_start(void);
+
+#endif
@@ -0,0 +1,122 @@
+/* log.c - Deferred binary logging */
+#include "log.h"
+#include "sync.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "io.h"
+
+// Producers on any CPU, in any context, reserve a slot by advancing
+// log_head and publish it by setting its seq; the single consumer frees it
+// by advancing log_tail. Nobody waits on anybody: a full ring drops.
+static log_record_t ring[LOG_RING_SIZE];
+static uint32_t log_head = 0;       // Next position to reserve
+static uint32_t log_tail = 0;       // Next position to drain
+static uint32_t log_dropped = 0;
+static uint32_t dropped_reported = 0;
+static int log_binary = 0;          // Drain sends frames for tools/logdecode
+static spinlock_t drain_lock;       // One consumer at a time
+
+uint8_t log_levels[LOG_SUB_COUNT] = { [0 ... LOG_SUB_COUNT - 1] = LOG_DEBUG };
+
+#define LOG_FORMAT_ENTRY(id, format) format "\n",
+static const char* const log_formats[] = { LOG_FORMATS(LOG_FORMAT_ENTRY) };
+
+void log_init(void) {
+    spinlock_init(&drain_lock, "log");
+}
+
+void log_set_level(log_subsystem_t sub, log_level_t level) {
+    if (sub < LOG_SUB_COUNT) log_levels[sub] = (uint8_t)level;
+}
+
+void log_set_binary(int enable) {
+    log_binary = enable;
+}
+
+// The whole cost of a LOG call that is not filtered out: a CAS, a TSC read
+// and a 32-byte store, with no formatting and no I/O
+void log_record(log_subsystem_t sub, log_level_t level, log_msg_t id,
+                const uint32_t* args, uint32_t nargs) {
+    uint32_t pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+    do {
+        if (pos - __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+            __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&log_head, &pos, pos + 1, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    
+    log_record_t* r = &ring[pos & (LOG_RING_SIZE - 1)];
+    uint64_t tsc = rdtsc();
+    if (nargs > LOG_MAX_ARGS) nargs = LOG_MAX_ARGS;
+    r->tsc_lo = (uint32_t)tsc;
+    r->tsc_hi = (uint32_t)(tsc >> 32);
+    r->id = (uint16_t)id;
+    r->sub_level = (uint8_t)(sub << 4 | level);
+    r->cpu_nargs = (uint8_t)(this_cpu()->id << 4 | nargs);
+    for (uint32_t i = 0; i < LOG_MAX_ARGS; i++) {
+        r->args[i] = i < nargs ? args[i] : 0;
+    }
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void log_emit(const log_record_t* r) {
+    if (log_binary) {
+        uint8_t frame[2 + sizeof(log_record_t)];
+        frame[0] = LOG_FRAME_MAGIC0;
+        frame[1] = LOG_FRAME_MAGIC1;
+        memcpy(frame + 2, r, sizeof(log_record_t));
+        serial_write(frame, sizeof(frame));
+        return;
+    }
+    if (r->id >= LOGMSG_COUNT) return;
+    printf_serial(log_formats[r->id], r->args[0], r->args[1], r->args[2], r->args[3]);
+}
+
+// Print every published record, oldest first, and return how many. Stops
+// at a slot whose producer has not finished filling it in.
+int log_drain(void) {
+    if (!spin_trylock(&drain_lock)) return 0;
+    
+    int drained = 0;
+    for (;;) {
+        uint32_t pos = log_tail;
+        log_record_t* r = &ring[pos & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != pos + 1) break;
+        log_record_t record = *r;
+        __atomic_store_n(&log_tail, pos + 1, __ATOMIC_RELEASE);
+        log_emit(&record);
+        drained++;
+    }
+    
+    uint32_t dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+    if (dropped != dropped_reported) {
+        printf_serial("[log] %u records dropped\n", dropped - dropped_reported);
+        dropped_reported = dropped;
+    }
+    spin_unlock(&drain_lock);
+    return drained;
+}
+
+// Background process that empties the ring, sleeping between batches so
+// formatting and serial output stay off the paths that log. Only
+// SCHED_PRIORITY ranks it by its priority, so it also steps aside by itself:
+// while other work is queued on its CPU it only drains once the ring is
+// half full, before records would start to drop.
+void log_drain_process(void) {
+    for (;;) {
+        uint32_t queued = __atomic_load_n(&log_head, __ATOMIC_RELAXED) -
+                          __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+        if (!this_cpu()->rq.nr_running || queued >= LOG_RING_SIZE / 2) {
+            log_drain();
+        }
+        block_current_process(WAIT_SLEEP, LOG_DRAIN_INTERVAL);
+    }
+}
+
+void log_stats(void) {
+    uint32_t head = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+    printf_serial("Log: %u recorded, %u queued, %u dropped, %s output\n", head, head - tail,
+                  __atomic_load_n(&log_dropped, __ATOMIC_RELAXED), log_binary ? "binary" : "text");
+}
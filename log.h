@@ -0,0 +1,74 @@
+/* log.h - Deferred binary logging */
+#ifndef LOG_H
+#define LOG_H
+
+#include "types.h"
+#include "log_formats.h"
+
+// LOG(SUB, LEVEL, id, args...) records the message id and up to
+// LOG_MAX_ARGS integer arguments in a lock-free ring; the drain process
+// formats and prints them later. A call above its subsystem's compile-time
+// ceiling (LOG_MAX_<SUB>, default LOG_COMPILE_LEVEL) is compiled out; the
+// rest are also filtered at run time by log_set_level.
+#define LOG_ID_ENUM(id, format) id,
+typedef enum { LOG_FORMATS(LOG_ID_ENUM) LOGMSG_COUNT } log_msg_t;
+
+#define LOG_NAME_ENUM(id, name) id,
+typedef enum { LOG_SUBSYSTEMS(LOG_NAME_ENUM) LOG_SUB_COUNT } log_subsystem_t;
+typedef enum { LOG_LEVELS(LOG_NAME_ENUM) } log_level_t;
+
+#define LOG_RING_SIZE       1024   // Records, power of two
+#define LOG_DRAIN_INTERVAL  5      // Ticks the drain process sleeps between checks
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+#ifndef LOG_MAX_SCHED
+#define LOG_MAX_SCHED LOG_COMPILE_LEVEL
+#endif
+#ifndef LOG_MAX_PROC
+#define LOG_MAX_PROC LOG_COMPILE_LEVEL
+#endif
+#ifndef LOG_MAX_IPC
+#define LOG_MAX_IPC LOG_COMPILE_LEVEL
+#endif
+#ifndef LOG_MAX_MEM
+#define LOG_MAX_MEM LOG_COMPILE_LEVEL
+#endif
+
+// One ring slot, 32 bytes. The decoder in tools/logdecode.c mirrors it.
+typedef struct {
+    uint32_t seq;               // Position + 1 once the slot is filled in
+    uint32_t tsc_lo;
+    uint32_t tsc_hi;
+    uint16_t id;                // log_msg_t
+    uint8_t sub_level;          // Subsystem << 4 | level
+    uint8_t cpu_nargs;          // CPU << 4 | argument count
+    uint32_t args[LOG_MAX_ARGS];
+} log_record_t;
+
+extern uint8_t log_levels[LOG_SUB_COUNT];
+
+void log_record(log_subsystem_t sub, log_level_t level, log_msg_t id,
+                const uint32_t* args, uint32_t nargs);
+
+#ifndef KACCHI_HOST
+#define LOG(sub, level, id, ...) do { \
+    if (level <= LOG_MAX_##sub && level <= log_levels[LOG_SUB_##sub]) { \
+        uint32_t log_args_[] = { 0, ##__VA_ARGS__ }; \
+        log_record(LOG_SUB_##sub, level, id, log_args_ + 1, \
+                   sizeof(log_args_) / sizeof(log_args_[0]) - 1); \
+    } \
+} while (0)
+#else
+#define LOG(sub, level, id, ...) do { } while (0)
+#endif
+
+void log_init(void);
+void log_set_level(log_subsystem_t sub, log_level_t level);
+void log_set_binary(int enable);
+int log_drain(void);
+void log_drain_process(void);
+void log_stats(void);
+
+#endif
@@ -0,0 +1,41 @@
+/* log_formats.h - Message table for the deferred log (log.h)
+
+   One entry per message: X(id, format). Only integer conversions (%d %u %x
+   %c) are allowed, since the arguments are formatted long after the call.
+   Shared with the host decoder (tools/logdecode.c), so it must not include
+   anything. Append new messages at the end: ids are the table positions. */
+#ifndef LOG_FORMATS_H
+#define LOG_FORMATS_H
+
+#define LOG_FORMATS(X) \
+    X(LOGMSG_CONTEXT_SWITCH,  "Context switch: PID %d -> PID %d") \
+    X(LOGMSG_QUANTUM_EXPIRED, "Time quantum expired for PID %d") \
+    X(LOGMSG_STATE_CHANGE,    "PID %d: %d -> %d") \
+    X(LOGMSG_TERMINATED,      "Terminated process PID %d") \
+    X(LOGMSG_MESSAGE_SENT,    "Message sent from PID %d to PID %d") \
+    X(LOGMSG_MESSAGE_HANDED,  "Message handed from PID %d to PID %d (%u bytes, zero-copy)") \
+    X(LOGMSG_STACK_RESERVED,  "Stack reserved for PID %d at 0x%x (%u bytes)") \
+    X(LOGMSG_STACK_FREED,     "Stack freed for PID %d (%u pages were committed)") \
+    X(LOGMSG_FREED,           "Freed memory at 0x%x")
+
+// Subsystems and levels, by value, for the same reason
+#define LOG_SUBSYSTEMS(X) \
+    X(LOG_SUB_SCHED, "sched") \
+    X(LOG_SUB_PROC,  "proc") \
+    X(LOG_SUB_IPC,   "ipc") \
+    X(LOG_SUB_MEM,   "mem")
+
+#define LOG_LEVELS(X) \
+    X(LOG_NONE,  "none") \
+    X(LOG_ERROR, "error") \
+    X(LOG_WARN,  "warn") \
+    X(LOG_INFO,  "info") \
+    X(LOG_DEBUG, "debug")
+
+// Binary frame the drain sends in binary mode: LOG_FRAME_MAGIC, then one
+// log_record_t as laid out in log.h, little-endian
+#define LOG_FRAME_MAGIC0 0x1B
+#define LOG_FRAME_MAGIC1 'L'
+#define LOG_MAX_ARGS     4
+
+#endif
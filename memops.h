@@ -0,0 +1,26 @@
+/* memops.h - Block copy and fill kernels behind memcpy/memset */
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include "types.h"
+
+// Crossovers from make bench-string, where rep's fixed startup cost stops
+// dominating. memcpy's moves with the host: rep already wins at 128 bytes
+// on some machines and only at 256 on others, so 128 is the lower bound;
+// raise it to 256 where bench-string still shows the byte loop ahead at 128
+#define MEMCPY_SMALL          128  // Below this, memcpy uses the byte loop
+#define MEMSET_SMALL          64   // Below this, memset uses the byte loop
+#define MEMOPS_SSE2_THRESHOLD 256  // Below this, rep movsd/stosd wins
+
+void memops_init(void);
+int memops_sse2_enabled(void);
+
+// Individual strategies, exported for benchmarking
+void* memcpy_bytes(void* dest, const void* src, size_t n);
+void* memcpy_rep(void* dest, const void* src, size_t n);
+void* memcpy_sse2(void* dest, const void* src, size_t n);
+void* memset_bytes(void* s, int c, size_t n);
+void* memset_rep(void* s, int c, size_t n);
+void* memset_sse2(void* s, int c, size_t n);
+
+#endif
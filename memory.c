@@ -1,175 +1,755 @@
-// memory.c
-#include "memory.h"
-#include "io.h"  // For serial output
-
-static mem_block_t* free_list = NULL;
-static stack_info_t stacks[MAX_BLOCKS];
-static int stack_count = 0;
-static uint32_t heap_used = 0;
-
-// Initialize memory manager
-void memory_init(void) {
-    uint32_t heap_start_addr = (uint32_t)&__kernel_end;
-    // Align to page boundary (4KB)
-    heap_start_addr = (heap_start_addr + 0xFFF) & ~0xFFF;
-    
-    // Initialize heap with one big free block
-    free_list = (mem_block_t*)heap_start_addr;
-    free_list->start_addr = heap_start_addr + sizeof(mem_block_t);
-    free_list->size = HEAP_SIZE - sizeof(mem_block_t);
-    free_list->is_free = 1;
-    free_list->next = NULL;
-    free_list->prev = NULL;
-    
-    stack_count = 0;
-    heap_used = 0;
-    
-    printf_serial("Memory manager initialized\n");
-    printf_serial("Heap starts at: 0x%x\n", heap_start_addr);
-    printf_serial("Heap size: %u bytes\n", HEAP_SIZE);
-}
-
-// Allocate stack for a process
-uint32_t allocate_stack(int pid) {
-    if (stack_count >= MAX_BLOCKS) {
-        printf_serial("Error: Maximum stack count reached\n");
-        return 0;
-    }
-    
-    // Allocate stack memory from heap
-    void* stack_addr = kmalloc(STACK_SIZE);
-    if (!stack_addr) {
-        printf_serial("Error: Failed to allocate stack for PID %d\n", pid);
-        return 0;
-    }
-    
-    // Record stack allocation
-    stacks[stack_count].base_addr = (uint32_t)stack_addr;
-    stacks[stack_count].size = STACK_SIZE;
-    stacks[stack_count].pid = pid;
-    stack_count++;
-    
-    printf_serial("Stack allocated for PID %d at 0x%x\n", pid, stack_addr);
-    return (uint32_t)stack_addr + STACK_SIZE;  // Return stack pointer (top of stack)
-}
-
-// Free stack when process terminates
-void free_stack(int pid) {
-    for (int i = 0; i < stack_count; i++) {
-        if (stacks[i].pid == pid) {
-            kfree((void*)stacks[i].base_addr);
-            
-            // Remove from array (shift remaining)
-            for (int j = i; j < stack_count - 1; j++) {
-                stacks[j] = stacks[j + 1];
-            }
-            stack_count--;
-            
-            printf_serial("Stack freed for PID %d\n", pid);
-            return;
-        }
-    }
-    printf_serial("Warning: No stack found for PID %d\n", pid);
-}
-
-// First-fit heap allocator
-void* kmalloc(uint32_t size) {
-    if (size == 0) return NULL;
-    
-    // Align to 8 bytes
-    size = (size + 7) & ~7;
-    
-    mem_block_t* current = free_list;
-    while (current) {
-        if (current->is_free && current->size >= size) {
-            // Split block if enough space left
-            if (current->size > size + sizeof(mem_block_t) + 8) {
-                mem_block_t* new_block = (mem_block_t*)(current->start_addr + size);
-                new_block->start_addr = current->start_addr + size + sizeof(mem_block_t);
-                new_block->size = current->size - size - sizeof(mem_block_t);
-                new_block->is_free = 1;
-                new_block->next = current->next;
-                new_block->prev = current;
-                
-                if (current->next) {
-                    current->next->prev = new_block;
-                }
-                current->next = new_block;
-                current->size = size;
-            }
-            
-            current->is_free = 0;
-            heap_used += current->size;
-            
-            return (void*)current->start_addr;
-        }
-        current = current->next;
-    }
-    
-    printf_serial("Error: Out of memory (requested %u bytes)\n", size);
-    return NULL;
-}
-
-// Free heap memory
-void kfree(void* ptr) {
-    if (!ptr) return;
-    
-    // Find the block containing this address
-    mem_block_t* current = free_list;
-    while (current) {
-        if ((void*)current->start_addr == ptr) {
-            current->is_free = 1;
-            heap_used -= current->size;
-            
-            // Coalesce with next block if free
-            if (current->next && current->next->is_free) {
-                current->size += sizeof(mem_block_t) + current->next->size;
-                current->next = current->next->next;
-                if (current->next) {
-                    current->next->prev = current;
-                }
-            }
-            
-            // Coalesce with previous block if free
-            if (current->prev && current->prev->is_free) {
-                current->prev->size += sizeof(mem_block_t) + current->size;
-                current->prev->next = current->next;
-                if (current->next) {
-                    current->next->prev = current->prev;
-                }
-            }
-            
-            printf_serial("Freed memory at 0x%x\n", ptr);
-            return;
-        }
-        current = current->next;
-    }
-    
-    printf_serial("Error: Attempt to free invalid address 0x%x\n", ptr);
-}
-
-// Display memory statistics
-void memory_stats(void) {
-    printf_serial("=== Memory Statistics ===\n");
-    printf_serial("Total heap: %u bytes\n", HEAP_SIZE);
-    printf_serial("Used heap: %u bytes\n", heap_used);
-    printf_serial("Free heap: %u bytes\n", HEAP_SIZE - heap_used);
-    printf_serial("Active stacks: %d\n", stack_count);
-    
-    mem_block_t* current = free_list;
-    int free_blocks = 0;
-    while (current) {
-        if (current->is_free) free_blocks++;
-        current = current->next;
-    }
-    printf_serial("Free blocks: %d\n", free_blocks);
-}
-
-// Utility functions
-uint32_t get_free_memory(void) {
-    return HEAP_SIZE - heap_used;
-}
-
-uint32_t get_total_memory(void) {
-    return HEAP_SIZE;
+// memory.c
+#include "memory.h"
+#include "process.h"  // For MAX_PROCESSES
+#include "paging.h"
+#include "log.h"
+#include "io.h"  // For serial output
+
+static mem_block_t* free_list = NULL;     // Free first-fit blocks only
+static uint32_t heap_used = 0;
+
+// Process stacks live apart from the kmalloc heap, in per-slot virtual
+// windows (see paging.h). Pages are faulted in on first touch; frames of
+// exited stacks are cached and handed out again LIFO, so a faulting stack
+// usually gets a frame that is still warm.
+static stack_info_t stacks[MAX_PROCESSES];
+static int stack_count = 0;
+static page_t* stack_cache = NULL;
+static uint32_t stack_cache_count = 0;
+static uint32_t stack_cache_hits = 0;
+static uint32_t stack_cache_misses = 0;
+static uint32_t stack_faults = 0;
+
+// Every page comes from the buddy allocator in page.c. Slab pages are single
+// frames, the first-fit heap is a set of HEAP_SIZE regions, and very large
+// requests get their own block. The frame descriptor of a pointer tells kfree
+// which of the three owns it. Each heap region is bracketed by a used footer
+// at its base and a used zero-size header at its end so coalescing never has
+// to bounds-check.
+static slab_class_t slab_classes[SLAB_NUM_CLASSES];
+static uint32_t heap_regions = 0;
+static uint32_t heap_region_bytes = 0;
+static uint32_t direct_pages = 0;
+
+static void* large_alloc(uint32_t size);
+static void large_free(void* ptr);
+
+// Boundary tag helpers
+static inline uintptr_t block_payload(mem_block_t* block) {
+    return (uintptr_t)(block + 1);
+}
+
+static inline mem_footer_t* block_footer(mem_block_t* block) {
+    return (mem_footer_t*)(block_payload(block) + block->size);
+}
+
+static inline mem_block_t* block_next(mem_block_t* block) {
+    return (mem_block_t*)(block_footer(block) + 1);
+}
+
+static inline mem_block_t* block_prev(mem_block_t* block) {
+    mem_footer_t* prev_footer = (mem_footer_t*)block - 1;
+    return (mem_block_t*)((uintptr_t)prev_footer - prev_footer->size - sizeof(mem_block_t));
+}
+
+static void block_set(mem_block_t* block, uint32_t size, uint32_t magic) {
+    block->size = size;
+    block->magic = magic;
+    mem_footer_t* footer = block_footer(block);
+    footer->size = size;
+    footer->magic = magic;
+}
+
+static void free_list_push(mem_block_t* block) {
+    block->prev = NULL;
+    block->next = free_list;
+    if (free_list) free_list->prev = block;
+    free_list = block;
+}
+
+static void free_list_remove(mem_block_t* block) {
+    if (block->prev) block->prev->next = block->next;
+    else free_list = block->next;
+    if (block->next) block->next->prev = block->prev;
+}
+
+// Add a new first-fit region able to hold at least `min_size` bytes
+static int heap_grow(uint32_t min_size) {
+    uint32_t bytes = min_size + BLOCK_OVERHEAD + sizeof(mem_footer_t) + sizeof(mem_block_t);
+    if (bytes < HEAP_SIZE) bytes = HEAP_SIZE;
+    
+    uint32_t order = page_order_for(bytes);
+    uintptr_t base = (uintptr_t)page_alloc(order, PAGE_HEAP);
+    if (!base) return 0;
+    bytes = (uint32_t)PAGE_SIZE << order;
+    
+    // Fenceposts, then one big free block in between
+    mem_footer_t* low_fence = (mem_footer_t*)base;
+    low_fence->size = 0;
+    low_fence->magic = BLOCK_MAGIC_USED;
+    mem_block_t* end_fence = (mem_block_t*)(base + bytes - sizeof(mem_block_t));
+    end_fence->size = 0;
+    end_fence->magic = BLOCK_MAGIC_USED;
+    
+    mem_block_t* first = (mem_block_t*)(low_fence + 1);
+    block_set(first, (uintptr_t)end_fence - (uintptr_t)first - BLOCK_OVERHEAD,
+              BLOCK_MAGIC_FREE);
+    free_list_push(first);
+    
+    heap_regions++;
+    heap_region_bytes += bytes;
+    return 1;
+}
+
+// Initialize memory manager (the page allocator must already be up)
+void memory_init(void) {
+    stack_count = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        stacks[i].base_addr = 0;
+        stacks[i].size = 0;
+        stacks[i].committed = 0;
+        stacks[i].pid = -1;
+    }
+    stack_cache = NULL;
+    stack_cache_count = 0;
+    stack_cache_hits = 0;
+    stack_cache_misses = 0;
+    stack_faults = 0;
+    heap_used = 0;
+    free_list = NULL;
+    heap_regions = 0;
+    heap_region_bytes = 0;
+    direct_pages = 0;
+    
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab_classes[i].obj_size = 1u << (i + SLAB_MIN_SHIFT);
+        slab_classes[i].objs_per_page = PAGE_SIZE / slab_classes[i].obj_size;
+        slab_classes[i].partial = NULL;
+        slab_classes[i].pages = 0;
+        slab_classes[i].in_use = 0;
+        slab_classes[i].allocs = 0;
+        slab_classes[i].frees = 0;
+    }
+    
+    if (!heap_grow(0)) {
+        printf_serial("Error: No memory for the initial heap region\n");
+        return;
+    }
+    
+    printf_serial("Memory manager initialized\n");
+    printf_serial("Heap starts at: 0x%x\n", (mem_footer_t*)free_list - 1);
+    printf_serial("Heap size: %u bytes\n", HEAP_SIZE);
+}
+
+static inline uintptr_t stack_window_top(int slot) {
+    return STACK_VIRT_BASE + (uintptr_t)(slot + 1) * STACK_WINDOW_SIZE;
+}
+
+// Reserve a stack of at least `size` bytes (0 = default) for PCB `slot`.
+// Nothing is committed here; pages are mapped by memory_stack_fault.
+uint32_t allocate_stack(int slot, int pid, uint32_t size) {
+    if (slot < 0 || slot >= MAX_PROCESSES || stacks[slot].base_addr) {
+        printf_serial("Error: Invalid or busy stack slot %d\n", slot);
+        return 0;
+    }
+    
+    if (size == 0) size = STACK_SIZE;
+    if (size < STACK_MIN_SIZE) size = STACK_MIN_SIZE;
+    if (size > STACK_MAX_SIZE) {
+        printf_serial("Error: Stack size %u exceeds maximum %u\n", size, STACK_MAX_SIZE);
+        return 0;
+    }
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    
+    // Record stack allocation
+    uintptr_t top = stack_window_top(slot);
+    stacks[slot].base_addr = top - size;
+    stacks[slot].size = size;
+    stacks[slot].committed = 0;
+    stacks[slot].pid = pid;
+    stack_count++;
+    
+    LOG(MEM, LOG_INFO, LOGMSG_STACK_RESERVED, pid, stacks[slot].base_addr, size);
+    return (uint32_t)top;  // Return stack pointer (top of stack)
+}
+
+// Free the stack of PCB `slot` when its process terminates
+void free_stack(int slot) {
+    if (slot < 0 || slot >= MAX_PROCESSES || !stacks[slot].base_addr) {
+        printf_serial("Warning: No stack found for slot %d\n", slot);
+        return;
+    }
+    
+    uintptr_t top = stack_window_top(slot);
+    for (uintptr_t va = stacks[slot].base_addr; va < top; va += PAGE_SIZE) {
+        uintptr_t frame = paging_unmap(va);
+        if (!frame) continue;
+        
+        if (stack_cache_count < STACK_CACHE_MAX) {
+            page_t* page = page_of((void*)frame);
+            page->next = stack_cache;
+            stack_cache = page;
+            stack_cache_count++;
+        } else {
+            page_free((void*)frame);
+        }
+    }
+    
+    LOG(MEM, LOG_INFO, LOGMSG_STACK_FREED, stacks[slot].pid, stacks[slot].committed);
+    stacks[slot].base_addr = 0;
+    stacks[slot].size = 0;
+    stacks[slot].committed = 0;
+    stacks[slot].pid = -1;
+    stack_count--;
+}
+
+// Page-fault hook: back a not-present page inside a reserved stack.
+// Returns 0 if the address is not part of any stack (including guards).
+static int do_memory_stack_fault(uintptr_t addr) {
+    if (addr < STACK_VIRT_BASE ||
+        addr >= STACK_VIRT_BASE + (uintptr_t)MAX_PROCESSES * STACK_WINDOW_SIZE) {
+        return 0;
+    }
+    
+    int slot = (int)((addr - STACK_VIRT_BASE) / STACK_WINDOW_SIZE);
+    stack_info_t* info = &stacks[slot];
+    if (!info->base_addr || addr < info->base_addr) {
+        printf_serial("Error: Stack overflow into guard area (slot %d, PID %d)\n",
+                      slot, info->pid);
+        return 0;
+    }
+    
+    // Most recently freed frame first; stacks need no zeroing
+    void* frame;
+    page_t* cached = stack_cache;
+    if (cached) {
+        stack_cache = cached->next;
+        stack_cache_count--;
+        frame = page_address(cached);
+        stack_cache_hits++;
+    } else {
+        frame = page_alloc(0, PAGE_STACK);
+        if (!frame) return 0;
+        stack_cache_misses++;
+    }
+    
+    if (!paging_map(addr & ~(uintptr_t)(PAGE_SIZE - 1), (uintptr_t)frame, PTE_WRITE)) {
+        page_free(frame);
+        return 0;
+    }
+    info->committed++;
+    stack_faults++;
+    return 1;
+}
+
+// The stack cache and windows are shared with allocate_stack/free_stack
+// running on other CPUs, so the fault task takes the kernel lock too
+int memory_stack_fault(uintptr_t addr) {
+    uint32_t irq = irq_save();
+    int handled = do_memory_stack_fault(addr);
+    irq_restore(irq);
+    return handled;
+}
+
+uint32_t get_stack_size(int slot) {
+    if (slot < 0 || slot >= MAX_PROCESSES) return 0;
+    return stacks[slot].size;
+}
+
+// Map a request size to its slab class (smallest power of two that fits)
+static int slab_class_index(uint32_t size) {
+    int idx = 0;
+    uint32_t obj = 1u << SLAB_MIN_SHIFT;
+    while (obj < size) {
+        obj <<= 1;
+        idx++;
+    }
+    return idx;
+}
+
+static void slab_partial_push(slab_class_t* cls, page_t* page) {
+    page->prev = NULL;
+    page->next = cls->partial;
+    if (cls->partial) cls->partial->prev = page;
+    cls->partial = page;
+    page->on_list = 1;
+}
+
+static void slab_partial_remove(slab_class_t* cls, page_t* page) {
+    if (page->prev) page->prev->next = page->next;
+    else cls->partial = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->next = NULL;
+    page->prev = NULL;
+    page->on_list = 0;
+}
+
+// Give a page to a size class and thread all of its objects onto a free list
+static page_t* slab_grow(int idx) {
+    slab_class_t* cls = &slab_classes[idx];
+    uintptr_t base = (uintptr_t)page_alloc(0, PAGE_SLAB);
+    if (!base) return NULL;
+    page_t* page = page_of((void*)base);
+    
+    void** prev_obj = &page->free_objs;
+    for (uint32_t i = 0; i < cls->objs_per_page; i++) {
+        void** obj = (void**)(base + i * cls->obj_size);
+        *prev_obj = obj;
+        prev_obj = (void**)obj;
+    }
+    *prev_obj = NULL;
+    
+    page->in_use = 0;
+    page->slab_class = (uint8_t)idx;
+    slab_partial_push(cls, page);
+    cls->pages++;
+    return page;
+}
+
+static void* slab_alloc(uint32_t size) {
+    int idx = slab_class_index(size);
+    slab_class_t* cls = &slab_classes[idx];
+    page_t* page = cls->partial;
+    
+    if (!page) {
+        page = slab_grow(idx);
+        if (!page) return NULL;
+    }
+    
+    void** obj = (void**)page->free_objs;
+    page->free_objs = *obj;
+    page->in_use++;
+    if (!page->free_objs) {
+        slab_partial_remove(cls, page);  // Page is now full
+    }
+    
+    cls->in_use++;
+    cls->allocs++;
+    heap_used += cls->obj_size;
+    return obj;
+}
+
+static void slab_free(page_t* page, void* ptr) {
+    slab_class_t* cls = &slab_classes[page->slab_class];
+    
+    *(void**)ptr = page->free_objs;
+    page->free_objs = ptr;
+    page->in_use--;
+    cls->in_use--;
+    cls->frees++;
+    heap_used -= cls->obj_size;
+    
+    if (!page->on_list) {
+        slab_partial_push(cls, page);
+    } else if (page->in_use == 0 && (cls->partial != page || page->next)) {
+        // Keep one empty page per class as a cushion, return the rest
+        slab_partial_remove(cls, page);
+        cls->pages--;
+        page_free(page_address(page));
+    }
+}
+
+// Small requests go to the slab layer, medium ones (and small ones the slab
+// layer cannot serve) to the first-fit heap, huge ones straight to pages
+static void* heap_alloc(uint32_t size) {
+    if (size <= SLAB_MAX_SIZE) {
+        void* obj = slab_alloc(size);
+        if (obj) return obj;
+    }
+    
+    if (size > HEAP_DIRECT_SIZE) {
+        if (size > PAGE_MAX_BLOCK) {
+            printf_serial("Error: Allocation of %u bytes exceeds the %u byte maximum\n",
+                          size, PAGE_MAX_BLOCK);
+            return NULL;
+        }
+        uint32_t order = page_order_for(size);
+        void* block = page_alloc(order, PAGE_LARGE);
+        if (!block) {
+            printf_serial("Error: Out of memory (requested %u bytes)\n", size);
+            return NULL;
+        }
+        direct_pages += 1u << order;
+        heap_used += (uint32_t)PAGE_SIZE << order;
+        return block;
+    }
+    
+    return large_alloc(size);
+}
+
+// Free heap memory; the owning frame says which allocator the pointer is from
+static void heap_free(void* ptr) {
+    page_t* page = page_of(ptr);
+    switch (page ? page->flags : PAGE_RESERVED) {
+        case PAGE_SLAB:
+            slab_free(page, ptr);
+            break;
+        case PAGE_HEAP:
+            large_free(ptr);
+            return;  // large_free reports on its own
+        case PAGE_LARGE:
+            if (((uintptr_t)ptr & (PAGE_SIZE - 1)) || page->order > PAGE_MAX_ORDER) {
+                printf_serial("Error: Attempt to free invalid address 0x%x\n", ptr);
+                return;
+            }
+            direct_pages -= 1u << page->order;
+            heap_used -= (uint32_t)PAGE_SIZE << page->order;
+            page_free(ptr);
+            break;
+        case PAGE_ARENA:
+            arena_free(page->arena, ptr);
+            return;
+        case PAGE_IPC:
+            ipc_buffer_free(ptr);
+            return;
+        default:
+            printf_serial("Error: Attempt to free invalid address 0x%x\n", ptr);
+            return;
+    }
+    
+    LOG(MEM, LOG_DEBUG, LOGMSG_FREED, (uint32_t)ptr);
+}
+
+// The allocators are shared by every process, so the timer must not
+// preempt one allocation in favour of another
+void* kmalloc(uint32_t size) {
+    if (size == 0) return NULL;
+    uint32_t irq = irq_save();
+    void* ptr = heap_alloc(size);
+    irq_restore(irq);
+    return ptr;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) return;
+    uint32_t irq = irq_save();
+    heap_free(ptr);
+    irq_restore(irq);
+}
+
+// Per-process arenas
+
+void arena_init(arena_t* arena, int pid) {
+    arena->chunks = NULL;
+    arena->ipc_buffers = NULL;
+    arena->cursor = 0;
+    arena->limit = 0;
+    arena->pages = 0;
+    arena->bytes_used = 0;
+    arena->peak_bytes = 0;
+    arena->live = 0;
+    arena->pid = pid;
+}
+
+// Start a new chunk big enough for `bytes`
+static int arena_grow(arena_t* arena, uint32_t bytes) {
+    if (bytes > PAGE_MAX_BLOCK) return 0;  // No chunk can hold it
+    uint32_t order = page_order_for(bytes);
+    void* chunk = page_alloc(order, PAGE_ARENA);
+    if (!chunk) return 0;
+    
+    page_t* head = page_of(chunk);
+    for (uint32_t i = 0; i < (1u << order); i++) {
+        head[i].arena = arena;
+    }
+    head->next = arena->chunks;
+    arena->chunks = head;
+    arena->cursor = (uintptr_t)chunk;
+    arena->limit = (uintptr_t)chunk + ((uintptr_t)PAGE_SIZE << order);
+    arena->pages += 1u << order;
+    return 1;
+}
+
+// Bump-allocate from the arena; memory goes back when the arena is released
+void* arena_alloc(arena_t* arena, uint32_t size) {
+    if (size == 0) return NULL;
+    
+    uint32_t total = ((size + 7) & ~7) + sizeof(arena_header_t);
+    if (size > PAGE_MAX_BLOCK ||  // Would wrap total
+        (arena->cursor + total > arena->limit && !arena_grow(arena, total))) {
+        printf_serial("Error: Arena of PID %d out of memory (requested %u bytes)\n",
+                      arena->pid, size);
+        return NULL;
+    }
+    
+    arena_header_t* header = (arena_header_t*)arena->cursor;
+    header->size = size;
+    header->magic = ARENA_MAGIC;
+    arena->cursor += total;
+    
+    arena->live++;
+    arena->bytes_used += size;
+    if (arena->bytes_used > arena->peak_bytes) {
+        arena->peak_bytes = arena->bytes_used;
+    }
+    return header + 1;
+}
+
+// Individual frees only update accounting; once nothing is live the arena
+// rewinds into its newest chunk and hands the older ones back
+void arena_free(arena_t* arena, void* ptr) {
+    arena_header_t* header = (arena_header_t*)ptr - 1;
+    if (header->magic != ARENA_MAGIC) {
+        printf_serial("Error: Attempt to free invalid arena address 0x%x\n", ptr);
+        return;
+    }
+    header->magic = 0;
+    arena->live--;
+    arena->bytes_used -= header->size;
+    
+    if (arena->live == 0 && arena->chunks) {
+        page_t* keep = arena->chunks;
+        page_t* chunk = keep->next;
+        while (chunk) {
+            page_t* next = chunk->next;
+            arena->pages -= 1u << chunk->order;
+            page_free(page_address(chunk));
+            chunk = next;
+        }
+        keep->next = NULL;
+        arena->cursor = (uintptr_t)page_address(keep);
+        arena->limit = arena->cursor + ((uintptr_t)PAGE_SIZE << keep->order);
+    }
+}
+
+// Drop every chunk and owned IPC buffer; cost is one page_free per block,
+// no matter how many allocations were made from it
+void arena_release(arena_t* arena) {
+    page_t* chunk = arena->chunks;
+    while (chunk) {
+        page_t* next = chunk->next;
+        page_free(page_address(chunk));
+        chunk = next;
+    }
+    while (arena->ipc_buffers) {
+        ipc_buffer_free(page_address(arena->ipc_buffers));
+    }
+    arena_init(arena, arena->pid);
+}
+
+// Zero-copy IPC buffers: whole page blocks owned by one process at a time.
+// Sending one moves the frame between owner lists instead of copying it;
+// everything is identity-mapped in the shared directory, so no remapping.
+
+static void ipc_buffer_link(arena_t* owner, page_t* head) {
+    head->arena = owner;
+    head->prev = NULL;
+    head->next = owner->ipc_buffers;
+    if (owner->ipc_buffers) owner->ipc_buffers->prev = head;
+    owner->ipc_buffers = head;
+    owner->pages += 1u << head->order;
+}
+
+static void ipc_buffer_unlink(page_t* head) {
+    arena_t* owner = head->arena;
+    if (head->prev) head->prev->next = head->next;
+    else owner->ipc_buffers = head->next;
+    if (head->next) head->next->prev = head->prev;
+    owner->pages -= 1u << head->order;
+    head->arena = NULL;
+}
+
+// Head frame of a live IPC buffer, or NULL if `buf` is not one
+static page_t* ipc_buffer_head(void* buf) {
+    page_t* page = page_of(buf);
+    if (!page || page->flags != PAGE_IPC || ((uintptr_t)buf & (PAGE_SIZE - 1)) ||
+        page->order > PAGE_MAX_ORDER || !page->arena) {
+        return NULL;
+    }
+    return page;
+}
+
+// Page-backed buffer of at least `size` bytes, owned by `owner`
+void* ipc_buffer_alloc(arena_t* owner, uint32_t size) {
+    if (size == 0) return NULL;
+    if (size > PAGE_MAX_BLOCK) {
+        printf_serial("Error: IPC buffer of %u bytes exceeds the %u byte maximum\n",
+                      size, PAGE_MAX_BLOCK);
+        return NULL;
+    }
+    void* buf = page_alloc(page_order_for(size), PAGE_IPC);
+    if (!buf) {
+        printf_serial("Error: Out of memory for IPC buffer (requested %u bytes)\n", size);
+        return NULL;
+    }
+    ipc_buffer_link(owner, page_of(buf));
+    return buf;
+}
+
+// Move ownership of `buf` from one arena to another. Fails (returns 0)
+// unless `from` currently owns it.
+int ipc_buffer_give(void* buf, arena_t* from, arena_t* to) {
+    page_t* head = ipc_buffer_head(buf);
+    if (!head || head->arena != from) return 0;
+    ipc_buffer_unlink(head);
+    ipc_buffer_link(to, head);
+    return 1;
+}
+
+void ipc_buffer_free(void* buf) {
+    page_t* head = ipc_buffer_head(buf);
+    if (!head) {
+        printf_serial("Error: Attempt to free invalid IPC buffer 0x%x\n", buf);
+        return;
+    }
+    ipc_buffer_unlink(head);
+    page_free(buf);
+}
+
+// Usable bytes in `buf` (whole pages), 0 if it is not an IPC buffer
+uint32_t ipc_buffer_size(void* buf) {
+    page_t* head = ipc_buffer_head(buf);
+    return head ? (uint32_t)PAGE_SIZE << head->order : 0;
+}
+
+// First-fit heap allocator over the explicit free list
+static void* large_alloc(uint32_t size) {
+    // Align to 8 bytes
+    size = (size + 7) & ~7;
+    
+    mem_block_t* current = free_list;
+    while (current) {
+        if (current->size >= size) {
+            free_list_remove(current);
+            
+            // Split block if enough space left
+            if (current->size >= size + BLOCK_OVERHEAD + 8) {
+                uint32_t rest = current->size - size - BLOCK_OVERHEAD;
+                block_set(current, size, BLOCK_MAGIC_USED);
+                mem_block_t* new_block = block_next(current);
+                block_set(new_block, rest, BLOCK_MAGIC_FREE);
+                free_list_push(new_block);
+            } else {
+                block_set(current, current->size, BLOCK_MAGIC_USED);
+            }
+            
+            heap_used += current->size;
+            return (void*)block_payload(current);
+        }
+        current = current->next;
+    }
+    
+    // Nothing fits: add a region and take its single free block
+    if (heap_grow(size)) {
+        return large_alloc(size);
+    }
+    
+    printf_serial("Error: Out of memory (requested %u bytes)\n", size);
+    return NULL;
+}
+
+// Return a first-fit block to the free list, merging with free neighbours.
+// The header is found from the pointer and validated against its footer, so
+// neither the lookup nor the coalescing walks any list.
+static void large_free(void* ptr) {
+    uintptr_t addr = (uintptr_t)ptr;
+    if (addr & 7) {
+        printf_serial("Error: Attempt to free invalid address 0x%x\n", ptr);
+        return;
+    }
+    
+    mem_block_t* block = (mem_block_t*)(addr - sizeof(mem_block_t));
+    if (block->magic == BLOCK_MAGIC_FREE && block_footer(block)->magic == BLOCK_MAGIC_FREE) {
+        printf_serial("Error: Double free at 0x%x\n", ptr);
+        return;
+    }
+    page_t* footer_page = page_of(block_footer(block));
+    if (block->magic != BLOCK_MAGIC_USED ||
+        !footer_page || footer_page->flags != PAGE_HEAP ||
+        block_footer(block)->magic != BLOCK_MAGIC_USED ||
+        block_footer(block)->size != block->size) {
+        printf_serial("Error: Attempt to free invalid address 0x%x\n", ptr);
+        return;
+    }
+    
+    heap_used -= block->size;
+    uint32_t size = block->size;
+    
+    // Coalesce with next block if free
+    mem_block_t* next = block_next(block);
+    if (next->magic == BLOCK_MAGIC_FREE) {
+        free_list_remove(next);
+        size += BLOCK_OVERHEAD + next->size;
+    }
+    
+    // Coalesce with previous block if free (it stays on the free list)
+    mem_footer_t* prev_footer = (mem_footer_t*)block - 1;
+    if (prev_footer->magic == BLOCK_MAGIC_FREE) {
+        block = block_prev(block);
+        block_set(block, block->size + BLOCK_OVERHEAD + size, BLOCK_MAGIC_FREE);
+    } else {
+        block_set(block, size, BLOCK_MAGIC_FREE);
+        free_list_push(block);
+    }
+    
+    // A block between both fenceposts means the whole region is idle;
+    // give it back unless it is the last one
+    prev_footer = (mem_footer_t*)block - 1;
+    if (heap_regions > 1 && prev_footer->size == 0 && block_next(block)->size == 0) {
+        free_list_remove(block);
+        heap_regions--;
+        heap_region_bytes -= (uint32_t)PAGE_SIZE << page_of(prev_footer)->order;
+        page_free(prev_footer);
+    }
+    
+    LOG(MEM, LOG_DEBUG, LOGMSG_FREED, (uint32_t)ptr);
+}
+
+// Display memory statistics
+void memory_stats(void) {
+    printf_serial("=== Memory Statistics ===\n");
+    page_stats();
+    printf_serial("Heap regions: %u (%u bytes)\n", heap_regions, heap_region_bytes);
+    printf_serial("Used heap: %u bytes\n", heap_used);
+    printf_serial("Direct page allocations: %u pages\n", direct_pages);
+    uint32_t committed = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        committed += stacks[i].committed;
+    }
+    printf_serial("Active stacks: %d (%u pages committed, %u faults)\n",
+                  stack_count, committed, stack_faults);
+    printf_serial("Stack frames: %u cached, %u reused, %u fresh\n",
+                  stack_cache_count, stack_cache_hits, stack_cache_misses);
+    
+    heap_info_t info;
+    memory_heap_info(&info);
+    printf_serial("Free blocks: %u (%u bytes, largest %u)\n",
+                  info.heap_free_blocks, info.heap_free_bytes, info.largest_free_block);
+    
+    printf_serial("Class\tPages\tIn use\tAllocs\tFrees\n");
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab_class_t* cls = &slab_classes[i];
+        if (cls->pages == 0 && cls->allocs == 0) continue;
+        printf_serial("%u\t%u\t%u/%u\t%u\t%u\n",
+                      cls->obj_size, cls->pages, cls->in_use,
+                      cls->pages * cls->objs_per_page,
+                      cls->allocs, cls->frees);
+    }
+}
+
+// Walks the free list, so meant for statistics rather than hot paths
+void memory_heap_info(heap_info_t* info) {
+    info->used_bytes = heap_used;
+    info->heap_bytes = heap_region_bytes;
+    info->heap_free_bytes = 0;
+    info->heap_free_blocks = 0;
+    info->largest_free_block = 0;
+    for (mem_block_t* block = free_list; block; block = block->next) {
+        info->heap_free_blocks++;
+        info->heap_free_bytes += block->size;
+        if (block->size > info->largest_free_block) {
+            info->largest_free_block = block->size;
+        }
+    }
+    info->free_pages = page_free_count();
+    info->largest_free_pages = page_largest_free();
+}
+
+// Utility functions
+uint32_t get_free_memory(void) {
+    return page_free_count() * PAGE_SIZE;
+}
+
+uint32_t get_total_memory(void) {
+    return page_total_count() * PAGE_SIZE;
 }
\ No newline at end of file
@@ -1,41 +1,117 @@
-// memory.h
-#ifndef MEMORY_H
-#define MEMORY_H
-
-#include "types.h"
-
-#define HEAP_START   ((uint32_t)&__kernel_end)  // Start after kernel
-#define HEAP_SIZE    0x00100000  // 1MB heap
-#define STACK_SIZE   0x00002000  // 8KB stack per process
-#define MAX_BLOCKS   256
-
-// External symbols from linker script
-extern uint32_t __kernel_end;
-
-// Memory block structure for heap management
-typedef struct mem_block {
-    uint32_t start_addr;
-    uint32_t size;
-    int is_free;
-    struct mem_block* next;
-    struct mem_block* prev;
-} mem_block_t;
-
-// Stack allocation record
-typedef struct {
-    uint32_t base_addr;
-    uint32_t size;
-    int pid;  // Process ID this stack belongs to
-} stack_info_t;
-
-// Memory Manager API
-void memory_init(void);
-uint32_t allocate_stack(int pid);
-void free_stack(int pid);
-void* kmalloc(uint32_t size);
-void kfree(void* ptr);
-void memory_stats(void);
-uint32_t get_free_memory(void);
-uint32_t get_total_memory(void);
-
+// memory.h
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "types.h"
+#include "page.h"
+
+#define HEAP_SIZE    0x00100000  // 1MB heap region (more are added on demand)
+#define HEAP_DIRECT_SIZE (HEAP_SIZE / 4)  // Larger requests bypass the heap
+#define STACK_SIZE   0x00002000  // Default 8KB stack per process
+#define STACK_MIN_SIZE   PAGE_SIZE
+#define STACK_MAX_SIZE   0x00010000  // 64KB
+#define STACK_CACHE_MAX  64          // Freed stack frames kept for reuse
+
+// Slab size classes: powers of two from 8 to 2048 bytes
+#define SLAB_MIN_SHIFT   3
+#define SLAB_MAX_SHIFT   11
+#define SLAB_NUM_CLASSES (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_MAX_SIZE    (1u << SLAB_MAX_SHIFT)
+
+// External symbols from linker script
+extern uint32_t __kernel_end;
+
+// Boundary-tagged heap block: a header directly before the payload and a
+// footer directly after it, so both physical neighbours are reachable in O(1)
+#define BLOCK_MAGIC_USED  0xB10CA11C
+#define BLOCK_MAGIC_FREE  0xB10CF7EE
+
+typedef struct mem_block {
+    uint32_t magic;             // BLOCK_MAGIC_USED or BLOCK_MAGIC_FREE
+    uint32_t size;              // Payload size in bytes
+    struct mem_block* next;     // Free-list links (valid only while free)
+    struct mem_block* prev;
+} mem_block_t;
+
+typedef struct {
+    uint32_t size;              // Copy of the header size
+    uint32_t magic;             // Copy of the header magic
+} mem_footer_t;
+
+#define BLOCK_OVERHEAD (sizeof(mem_block_t) + sizeof(mem_footer_t))
+
+// Per size-class bookkeeping
+typedef struct {
+    uint32_t obj_size;
+    uint32_t objs_per_page;
+    page_t* partial;            // Slab pages with at least one free object
+    uint32_t pages;             // Pages currently owned by this class
+    uint32_t in_use;            // Live objects
+    uint32_t allocs;
+    uint32_t frees;
+} slab_class_t;
+
+// Per-process bump arena. Chunks are page blocks linked through the head
+// frame's page_t::next; releasing the arena returns them all at once.
+#define ARENA_MAGIC       0xA4E4A001
+
+typedef struct arena {
+    page_t* chunks;             // Newest chunk first
+    page_t* ipc_buffers;        // IPC buffers this process owns
+    uintptr_t cursor;           // Next free byte in the newest chunk
+    uintptr_t limit;            // End of the newest chunk
+    uint32_t pages;             // Pages held by the arena (chunks and IPC buffers)
+    uint32_t bytes_used;        // Live bytes (payload only)
+    uint32_t peak_bytes;
+    uint32_t live;              // Live allocations
+    int pid;
+} arena_t;
+
+// Header in front of every arena allocation
+typedef struct {
+    uint32_t size;
+    uint32_t magic;
+} arena_header_t;
+
+// Fragmentation snapshot (see memory_heap_info)
+typedef struct {
+    uint32_t used_bytes;        // Bytes handed out by kmalloc
+    uint32_t heap_bytes;        // Bytes in first-fit regions
+    uint32_t heap_free_bytes;   // Sum of free first-fit payloads
+    uint32_t heap_free_blocks;
+    uint32_t largest_free_block;
+    uint32_t free_pages;
+    uint32_t largest_free_pages; // Largest free buddy block
+} heap_info_t;
+
+// Stack allocation record, one per PCB slot. The stack is reserved in the
+// slot's virtual window; frames are only committed when first touched.
+typedef struct {
+    uintptr_t base_addr;        // Lowest stack address, 0 when the slot has no stack
+    uint32_t size;
+    uint32_t committed;         // Pages currently backed by a frame
+    int pid;  // Process ID this stack belongs to
+} stack_info_t;
+
+// Memory Manager API
+void memory_init(void);
+uint32_t allocate_stack(int slot, int pid, uint32_t size);
+void free_stack(int slot);
+uint32_t get_stack_size(int slot);
+int memory_stack_fault(uintptr_t addr);
+void* kmalloc(uint32_t size);
+void kfree(void* ptr);
+void memory_stats(void);
+void memory_heap_info(heap_info_t* info);
+void arena_init(arena_t* arena, int pid);
+void* arena_alloc(arena_t* arena, uint32_t size);
+void arena_free(arena_t* arena, void* ptr);
+void arena_release(arena_t* arena);
+void* ipc_buffer_alloc(arena_t* owner, uint32_t size);
+int ipc_buffer_give(void* buf, arena_t* from, arena_t* to);
+void ipc_buffer_free(void* buf);
+uint32_t ipc_buffer_size(void* buf);
+uint32_t get_free_memory(void);
+uint32_t get_total_memory(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+/* multiboot.h - Multiboot (v1) information structures */
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "types.h"
+
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+// multiboot_info_t::flags bits
+#define MULTIBOOT_INFO_MEMORY   0x00000001  // mem_lower/mem_upper valid
+#define MULTIBOOT_INFO_MEM_MAP  0x00000040  // mmap_addr/mmap_length valid
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+// Information structure handed to the kernel in EBX
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;         // KB of memory below 1MB
+    uint32_t mem_upper;         // KB of memory above 1MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;       // Bytes of memory map
+    uint32_t mmap_addr;         // Physical address of the first entry
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+} __attribute__((packed)) multiboot_info_t;
+
+// Memory map entry; `size` does not count itself
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
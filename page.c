@@ -0,0 +1,244 @@
+// page.c - Buddy allocator for physical page frames
+#include "page.h"
+#include "memory.h"
+#include "io.h"
+
+static page_t* frames = NULL;        // Descriptor for every frame from address 0
+static uint32_t frame_count = 0;
+static page_t* free_area[PAGE_NUM_ORDERS];
+static uint32_t free_blocks[PAGE_NUM_ORDERS];
+static uint32_t free_pages = 0;
+static uint32_t total_pages = 0;
+
+static void free_area_push(uint32_t order, page_t* page) {
+    page->flags = PAGE_FREE;
+    page->order = (uint8_t)order;
+    page->prev = NULL;
+    page->next = free_area[order];
+    if (free_area[order]) free_area[order]->prev = page;
+    free_area[order] = page;
+    free_blocks[order]++;
+}
+
+static void free_area_remove(uint32_t order, page_t* page) {
+    if (page->prev) page->prev->next = page->next;
+    else free_area[order] = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->next = NULL;
+    page->prev = NULL;
+    page->flags = PAGE_USED;
+    free_blocks[order]--;
+}
+
+// Hand [start, end) to the allocator as maximal naturally aligned blocks
+static void add_free_range(uintptr_t start, uintptr_t end) {
+    uint32_t pfn = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t last = end >> PAGE_SHIFT;
+    if (last > frame_count) last = frame_count;
+    
+    while (pfn < last) {
+        uint32_t order = PAGE_MAX_ORDER;
+        while (order > 0 &&
+               ((pfn & ((1u << order) - 1)) || pfn + (1u << order) > last)) {
+            order--;
+        }
+        free_area_push(order, &frames[pfn]);
+        free_pages += 1u << order;
+        total_pages += 1u << order;
+        pfn += 1u << order;
+    }
+}
+
+// Usable RAM regions reported by the boot loader, clipped to 32 bits
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+} mem_range_t;
+
+#define MAX_MEM_RANGES 32
+
+static int collect_ranges(multiboot_info_t* mbi, mem_range_t* ranges) {
+    int count = 0;
+    
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uintptr_t entry_addr = mbi->mmap_addr;
+        uintptr_t map_end = mbi->mmap_addr + mbi->mmap_length;
+        while (entry_addr < map_end && count < MAX_MEM_RANGES) {
+            multiboot_mmap_entry_t* entry = (multiboot_mmap_entry_t*)entry_addr;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr < 0xFFFFF000ull) {
+                uint64_t end = entry->addr + entry->len;
+                if (end > 0xFFFFF000ull) end = 0xFFFFF000ull;
+                ranges[count].start = (uintptr_t)entry->addr;
+                ranges[count].end = (uintptr_t)end;
+                count++;
+            }
+            entry_addr += entry->size + sizeof(entry->size);
+        }
+    } else if (mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        ranges[0].start = 0x100000;
+        ranges[0].end = 0x100000 + (uintptr_t)mbi->mem_upper * 1024;
+        count = 1;
+    }
+    
+    if (count == 0) {
+        // No usable information: assume the old fixed heap layout
+        ranges[0].start = (uintptr_t)&__kernel_end;
+        ranges[0].end = (uintptr_t)&__kernel_end + 4 * HEAP_SIZE;
+        count = 1;
+    }
+    return count;
+}
+
+// Build the frame descriptor array right after the kernel image and free
+// every usable frame above it. Low memory and the kernel stay reserved.
+void page_init(multiboot_info_t* mbi) {
+    mem_range_t ranges[MAX_MEM_RANGES];
+    int count = collect_ranges(mbi, ranges);
+    
+    uintptr_t top = 0;
+    for (int i = 0; i < count; i++) {
+        if (ranges[i].end > top) top = ranges[i].end;
+    }
+    frame_count = top >> PAGE_SHIFT;
+    
+    uintptr_t kernel_end = ((uintptr_t)&__kernel_end + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+    frames = (page_t*)kernel_end;
+    memset(frames, 0, frame_count * sizeof(page_t));
+    uintptr_t first_free = (kernel_end + frame_count * sizeof(page_t) + PAGE_SIZE - 1)
+                           & ~(uintptr_t)(PAGE_SIZE - 1);
+    
+    for (int i = 0; i < PAGE_NUM_ORDERS; i++) {
+        free_area[i] = NULL;
+        free_blocks[i] = 0;
+    }
+    free_pages = 0;
+    total_pages = 0;
+    
+    for (int i = 0; i < count; i++) {
+        uintptr_t start = ranges[i].start < first_free ? first_free : ranges[i].start;
+        if (start < ranges[i].end) {
+            add_free_range(start, ranges[i].end);
+        }
+    }
+    
+    printf_serial("Page allocator initialized\n");
+    printf_serial("Physical memory: %u KB usable in %d ranges, %u frames tracked\n",
+                  total_pages * (PAGE_SIZE / 1024), count, frame_count);
+}
+
+// Allocate 2^order contiguous frames and tag them with their owner
+void* page_alloc(uint32_t order, uint8_t flags) {
+    if (order > PAGE_MAX_ORDER) return NULL;
+    
+    uint32_t irq = irq_save();
+    uint32_t k = order;
+    while (k <= PAGE_MAX_ORDER && !free_area[k]) k++;
+    if (k > PAGE_MAX_ORDER) {
+        irq_restore(irq);
+        printf_serial("Error: Out of page frames (order %u)\n", order);
+        return NULL;
+    }
+    
+    page_t* page = free_area[k];
+    free_area_remove(k, page);
+    
+    // Split, returning the upper halves to the smaller free lists
+    while (k > order) {
+        k--;
+        free_area_push(k, page + (1u << k));
+    }
+    
+    for (uint32_t i = 0; i < (1u << order); i++) {
+        page[i].flags = flags;
+        page[i].order = PAGE_ORDER_TAIL;
+    }
+    page->order = (uint8_t)order;
+    free_pages -= 1u << order;
+    irq_restore(irq);
+    return page_address(page);
+}
+
+// Return a block to the allocator, merging with its buddy while possible.
+// `addr` must be the start of the block: freeing from one of its tail
+// frames would hand part of a live block to the free lists.
+void page_free(void* addr) {
+    uint32_t irq = irq_save();
+    page_t* page = page_of(addr);
+    if (!page || ((uintptr_t)addr & (PAGE_SIZE - 1)) || page->order > PAGE_MAX_ORDER ||
+        page->flags == PAGE_FREE || page->flags == PAGE_RESERVED) {
+        irq_restore(irq);
+        printf_serial("Error: Attempt to free invalid page 0x%x\n", addr);
+        return;
+    }
+    
+    uint32_t order = page->order;
+    uint32_t pfn = (uint32_t)(page - frames);
+    for (uint32_t i = 0; i < (1u << order); i++) {
+        page[i].flags = PAGE_USED;
+    }
+    free_pages += 1u << order;
+    
+    while (order < PAGE_MAX_ORDER) {
+        uint32_t buddy_pfn = pfn ^ (1u << order);
+        if (buddy_pfn >= frame_count) break;
+        page_t* buddy = &frames[buddy_pfn];
+        if (buddy->flags != PAGE_FREE || buddy->order != order) break;
+        
+        free_area_remove(order, buddy);
+        pfn &= ~(1u << order);
+        order++;
+    }
+    
+    free_area_push(order, &frames[pfn]);
+    irq_restore(irq);
+}
+
+page_t* page_of(const void* addr) {
+    uint32_t pfn = (uint32_t)((uintptr_t)addr >> PAGE_SHIFT);
+    return pfn < frame_count ? &frames[pfn] : NULL;
+}
+
+void* page_address(page_t* page) {
+    return (void*)((uintptr_t)(page - frames) << PAGE_SHIFT);
+}
+
+// Smallest order whose block holds `bytes`. Above PAGE_MAX_BLOCK this is
+// PAGE_MAX_ORDER + 1, which page_alloc refuses.
+uint32_t page_order_for(uint32_t bytes) {
+    if (bytes > PAGE_MAX_BLOCK) return PAGE_MAX_ORDER + 1;
+    uint32_t order = 0;
+    while (((uint32_t)PAGE_SIZE << order) < bytes) {
+        order++;
+    }
+    return order;
+}
+
+uint32_t page_free_count(void) {
+    return free_pages;
+}
+
+uint32_t page_total_count(void) {
+    return total_pages;
+}
+
+// Pages in the largest free block (0 if memory is exhausted)
+uint32_t page_largest_free(void) {
+    for (int order = PAGE_MAX_ORDER; order >= 0; order--) {
+        if (free_area[order]) return 1u << order;
+    }
+    return 0;
+}
+
+// End of the highest physical frame tracked
+uintptr_t page_memory_top(void) {
+    return (uintptr_t)frame_count << PAGE_SHIFT;
+}
+
+void page_stats(void) {
+    printf_serial("Page frames: %u free / %u total\n", free_pages, total_pages);
+    printf_serial("Free blocks per order:");
+    for (int i = 0; i < PAGE_NUM_ORDERS; i++) {
+        printf_serial(" %u", free_blocks[i]);
+    }
+    printf_serial("\n");
+}
@@ -0,0 +1,55 @@
+// page.h
+#ifndef PAGE_H
+#define PAGE_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE       0x00001000  // 4KB page frame
+#define PAGE_SHIFT      12
+#define PAGE_MAX_ORDER  10          // Largest buddy block: 2^10 pages = 4MB
+#define PAGE_NUM_ORDERS (PAGE_MAX_ORDER + 1)
+#define PAGE_MAX_BLOCK  ((uint32_t)PAGE_SIZE << PAGE_MAX_ORDER)  // Largest single allocation
+#define PAGE_ORDER_TAIL 0xFF        // page_t::order of every frame of a block but its head
+
+// Frame ownership (page_t::flags)
+#define PAGE_RESERVED   0x00  // Not managed (kernel image, BIOS, holes)
+#define PAGE_FREE       0x01  // Head of a free buddy block
+#define PAGE_USED       0x02  // Allocated, no specific owner
+#define PAGE_SLAB       0x03  // Slab page for small kmalloc objects
+#define PAGE_HEAP       0x04  // Part of a first-fit heap region
+#define PAGE_LARGE      0x05  // Direct page allocation from kmalloc
+#define PAGE_STACK      0x06  // Process stack
+#define PAGE_ARENA      0x07  // Chunk of a per-process arena
+#define PAGE_IPC        0x08  // Zero-copy IPC buffer
+
+// Physical frame descriptor, one per 4KB frame
+typedef struct page {
+    struct page* next;          // Buddy free list, or owner list (slab partial, IPC buffers)
+    struct page* prev;
+    uint8_t order;              // Block order on the head frame, PAGE_ORDER_TAIL on the rest
+    uint8_t flags;              // PAGE_* owner
+    uint8_t slab_class;         // Slab: size class index
+    uint8_t on_list;            // Slab: linked into the class partial list
+    uint16_t in_use;            // Slab: live objects in this page
+    union {
+        void* free_objs;        // Slab: free objects in this page
+        struct arena* arena;    // Arena: owning arena (set on every frame)
+                                // IPC: owning process's arena (head frame)
+    };
+} page_t;
+
+// Page Frame Allocator API
+void page_init(multiboot_info_t* mbi);
+void* page_alloc(uint32_t order, uint8_t flags);
+void page_free(void* addr);
+page_t* page_of(const void* addr);
+void* page_address(page_t* page);
+uint32_t page_order_for(uint32_t bytes);
+uint32_t page_free_count(void);
+uint32_t page_total_count(void);
+uintptr_t page_memory_top(void);
+uint32_t page_largest_free(void);
+void page_stats(void);
+
+#endif
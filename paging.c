@@ -0,0 +1,146 @@
+// paging.c - Kernel address space and page-fault handling
+#include "paging.h"
+#include "page.h"
+#include "memory.h"
+#include "gdt.h"
+#include "idt.h"
+#include "io.h"
+
+#define PD_ENTRIES 1024
+
+static uint32_t kernel_page_directory[PD_ENTRIES] __attribute__((aligned(4096)));
+static volatile uint32_t tlb_generation = 0;  // Bumped by every unmap
+
+static inline void invlpg(uintptr_t virt) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+static int cpu_has_pse(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 3) & 1;
+}
+
+// Page table covering `virt`, allocated on first use
+static uint32_t* page_table_for(uintptr_t virt, int create) {
+    uint32_t* pde = &kernel_page_directory[virt >> 22];
+    if (!(*pde & PTE_PRESENT)) {
+        if (!create) return NULL;
+        uint32_t* table = (uint32_t*)page_alloc(0, PAGE_USED);
+        if (!table) return NULL;
+        memset(table, 0, PAGE_SIZE);
+        *pde = (uint32_t)(uintptr_t)table | PTE_PRESENT | PTE_WRITE;
+    }
+    return (uint32_t*)(uintptr_t)(*pde & ~0xFFFu);
+}
+
+// Identity-map all of physical memory with 4MB pages, so the whole kernel
+// (image, frame descriptors, heap) costs a handful of TLB entries, then turn
+// paging on. Without PSE the same range is mapped with 4KB tables instead.
+void paging_init(void) {
+    memset(kernel_page_directory, 0, sizeof(kernel_page_directory));
+    
+    uintptr_t top = (uintptr_t)page_memory_top();
+    if (top > STACK_VIRT_BASE) top = STACK_VIRT_BASE;
+    uint32_t large_pages = (uint32_t)((top + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE);
+    int pse = cpu_has_pse();
+    
+    for (uint32_t i = 0; i < large_pages; i++) {
+        uintptr_t phys = (uintptr_t)i * LARGE_PAGE_SIZE;
+        if (pse) {
+            kernel_page_directory[i] = phys | PTE_PRESENT | PTE_WRITE | PTE_LARGE;
+        } else {
+            uint32_t* table = page_table_for(phys, 1);
+            for (uint32_t j = 0; j < 1024; j++) {
+                table[j] = (phys + j * PAGE_SIZE) | PTE_PRESENT | PTE_WRITE;
+            }
+        }
+    }
+    
+    uint32_t cr3 = (uint32_t)(uintptr_t)kernel_page_directory;
+    gdt_set_cr3(cr3);
+    
+    uint32_t cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    if (pse) cr4 |= 0x10;  // CR4.PSE
+    __asm__ volatile (
+        "mov %0, %%cr4\n"
+        "mov %1, %%cr3\n"
+        "mov %%cr0, %%eax\n"
+        "or $0x80000000, %%eax\n"  // CR0.PG
+        "mov %%eax, %%cr0\n"
+        : : "r"(cr4), "r"(cr3) : "eax", "memory");
+    
+    printf_serial("Paging enabled: %u MB identity mapped with %s pages\n",
+                  large_pages * 4, pse ? "4MB" : "4KB");
+}
+
+uint32_t* paging_kernel_directory(void) {
+    return kernel_page_directory;
+}
+
+// Map one 4KB page; returns 0 if no page table could be allocated
+int paging_map(uintptr_t virt, uintptr_t phys, uint32_t flags) {
+    uint32_t* table = page_table_for(virt, 1);
+    if (!table) return 0;
+    table[(virt >> 12) & 0x3FF] = (uint32_t)(phys & ~0xFFFu) | flags | PTE_PRESENT;
+    invlpg(virt);
+    return 1;
+}
+
+// Unmap one 4KB page and return the frame it pointed to (0 if none)
+uintptr_t paging_unmap(uintptr_t virt) {
+    uint32_t* table = page_table_for(virt, 0);
+    if (!table) return 0;
+    uint32_t* pte = &table[(virt >> 12) & 0x3FF];
+    if (!(*pte & PTE_PRESENT)) return 0;
+    uintptr_t phys = *pte & ~0xFFFu;
+    *pte = 0;
+    invlpg(virt);
+    tlb_generation++;
+    return phys;
+}
+
+// Identity-map [phys, phys + size) with `flags` (firmware tables, device
+// registers). Pages already mapped, including under a 4MB page, are left
+// alone. Returns 0 if a page table could not be allocated.
+int paging_identity_map(uintptr_t phys, uint32_t size, uint32_t flags) {
+    uintptr_t end = phys + size;
+    for (uintptr_t page = phys & ~0xFFFu; page < end; page += PAGE_SIZE) {
+        uint32_t pde = kernel_page_directory[page >> 22];
+        if ((pde & PTE_PRESENT) && (pde & PTE_LARGE)) continue;
+        uint32_t* table = page_table_for(page, 1);
+        if (!table) return 0;
+        uint32_t* pte = &table[(page >> 12) & 0x3FF];
+        if (*pte & PTE_PRESENT) continue;
+        *pte = (uint32_t)page | flags | PTE_PRESENT;
+        invlpg(page);
+        if (page + PAGE_SIZE < page) break;  // Wrapped at 4GB
+    }
+    return 1;
+}
+
+// Other CPUs only invalidate their own TLBs. A CPU whose generation is
+// behind may still hold a translation for an unmapped stack page, so the
+// scheduler flushes before it runs a process there (see context_switch).
+uint32_t paging_tlb_generation(void) {
+    return tlb_generation;
+}
+
+void paging_flush_tlb(void) {
+    uint32_t cr3;
+    __asm__ volatile ("mov %%cr3, %0\n mov %0, %%cr3" : "=r"(cr3) : : "memory");
+}
+
+// Runs in the page-fault task (see gdt.c) with interrupts off
+void page_fault_handler(uint32_t error_code, uint32_t fault_addr) {
+    if (!(error_code & PF_PRESENT) && memory_stack_fault(fault_addr)) {
+        return;
+    }
+    
+    printf_serial("\nPage fault at 0x%x (%s, %s), EIP 0x%x\n", fault_addr,
+                  (error_code & PF_PRESENT) ? "protection" : "not present",
+                  (error_code & PF_WRITE) ? "write" : "read",
+                  gdt_main_tss()->eip);
+    panic("Unrecoverable page fault");
+}
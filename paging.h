@@ -0,0 +1,34 @@
+// paging.h
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+
+// Page directory / table entry bits
+#define PTE_PRESENT   0x001
+#define PTE_WRITE     0x002
+#define PTE_PCD       0x010  // Cache disable (MMIO)
+#define PTE_LARGE     0x080  // 4MB page (PDE with CR4.PSE)
+
+#define LARGE_PAGE_SIZE 0x00400000  // 4MB
+
+// Page-fault error code bits
+#define PF_PRESENT    0x1
+#define PF_WRITE      0x2
+
+// Process stacks live in a virtual region above the identity map. Each PCB
+// slot owns a window whose top STACK_MAX_SIZE bytes at most hold the stack;
+// everything below the stack stays unmapped and acts as a guard.
+#define STACK_VIRT_BASE   0xD0000000
+#define STACK_WINDOW_SIZE 0x00020000  // 128KB per slot, > STACK_MAX_SIZE
+
+void paging_init(void);
+uint32_t* paging_kernel_directory(void);
+int paging_map(uintptr_t virt, uintptr_t phys, uint32_t flags);
+uintptr_t paging_unmap(uintptr_t virt);
+int paging_identity_map(uintptr_t phys, uint32_t size, uint32_t flags);
+uint32_t paging_tlb_generation(void);
+void paging_flush_tlb(void);
+void page_fault_handler(uint32_t error_code, uint32_t fault_addr);
+
+#endif
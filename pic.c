@@ -0,0 +1,73 @@
+/* pic.c - 8259A programmable interrupt controller pair */
+#include "pic.h"
+#include "io.h"
+
+#define ICW1_INIT  0x10
+#define ICW1_ICW4  0x01
+#define ICW4_8086  0x01
+#define OCW3_READ_ISR 0x0B
+
+// The old PCs' 8259s need a moment between writes; port 0x80 is a
+// harmless POST-code port that costs about a microsecond
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+// Move IRQs 0-15 off the CPU exception vectors, to master_base and
+// slave_base, and mask everything except the cascade line
+void pic_init(uint8_t master_base, uint8_t slave_base) {
+    outb(PIC1_CMD, ICW1_INIT | ICW1_ICW4);
+    io_wait();
+    outb(PIC2_CMD, ICW1_INIT | ICW1_ICW4);
+    io_wait();
+    outb(PIC1_DATA, master_base);
+    io_wait();
+    outb(PIC2_DATA, slave_base);
+    io_wait();
+    outb(PIC1_DATA, 1 << PIC_CASCADE_IRQ);  // Slave on IRQ2
+    io_wait();
+    outb(PIC2_DATA, PIC_CASCADE_IRQ);       // Slave cascade identity
+    io_wait();
+    outb(PIC1_DATA, ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, ICW4_8086);
+    io_wait();
+    
+    outb(PIC1_DATA, (uint8_t)~(1 << PIC_CASCADE_IRQ));
+    outb(PIC2_DATA, 0xFF);
+    
+    printf_serial("PIC remapped to vectors 0x%x/0x%x\n", master_base, slave_base);
+}
+
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_CMD, PIC_EOI);
+    }
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+void pic_mask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+void pic_unmask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+// IRQ7/IRQ15 fire spuriously when a request goes away before the CPU
+// acknowledges it; the in-service bit is clear then and no EOI is owed
+// (except to the master for a spurious slave interrupt)
+int pic_is_spurious(uint8_t irq) {
+    if (irq != 7 && irq != 15) return 0;
+    
+    uint16_t cmd = irq == 7 ? PIC1_CMD : PIC2_CMD;
+    outb(cmd, OCW3_READ_ISR);
+    if (inb(cmd) & 0x80) return 0;
+    
+    if (irq == 15) {
+        outb(PIC1_CMD, PIC_EOI);
+    }
+    return 1;
+}
@@ -0,0 +1,21 @@
+/* pic.h - 8259A programmable interrupt controller pair */
+#ifndef PIC_H
+#define PIC_H
+
+#include "types.h"
+
+#define PIC1_CMD   0x20
+#define PIC1_DATA  0x21
+#define PIC2_CMD   0xA0
+#define PIC2_DATA  0xA1
+
+#define PIC_EOI    0x20
+#define PIC_CASCADE_IRQ 2
+
+void pic_init(uint8_t master_base, uint8_t slave_base);
+void pic_send_eoi(uint8_t irq);
+void pic_mask(uint8_t irq);
+void pic_unmask(uint8_t irq);
+int pic_is_spurious(uint8_t irq);
+
+#endif
@@ -0,0 +1,70 @@
+/* pit.c - 8253/8254 programmable interval timer */
+#include "pit.h"
+#include "idt.h"
+#include "pic.h"
+#include "io.h"
+#include "scheduler.h"
+
+static uint32_t tick_hz = 0;
+static uint32_t tick_divisor = 0;
+static uint32_t tsc_rate_khz = 0;
+
+static void pit_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    timer_tick();
+}
+
+// Program channel 0 as a rate generator at `hz` and drive timer_tick
+// from IRQ0. The divisor is 16 bits, so hz is clamped to 19..1193182.
+void pit_init(uint32_t hz) {
+    if (hz == 0) hz = TIMER_HZ;
+    uint32_t divisor = PIT_BASE_HZ / hz;
+    if (divisor == 0) divisor = 1;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+    tick_hz = PIT_BASE_HZ / divisor;
+    tick_divisor = divisor;
+    
+    outb(PIT_COMMAND, 0x34);  // Channel 0, lo/hi byte, mode 2, binary
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+    
+    register_irq_handler(IRQ_TIMER, pit_irq);
+    pic_unmask(IRQ_TIMER);
+    
+    printf_serial("PIT running at %u Hz (divisor %u)\n", tick_hz, divisor);
+}
+
+// Actual tick rate after rounding the divisor
+uint32_t pit_hz(void) {
+    return tick_hz;
+}
+
+// Count TSC cycles across TSC_CALIBRATE_TICKS PIT ticks. Needs the PIT
+// running and interrupts enabled; both ends are taken right after a tick,
+// so the interrupt latency cancels out.
+void tsc_calibrate(void) {
+    if (!tick_divisor) return;
+    
+    uint32_t start = get_ticks();
+    while (get_ticks() == start) __asm__ volatile ("hlt");
+    uint64_t tsc_start = rdtsc();
+    start = get_ticks();
+    while (get_ticks() - start < TSC_CALIBRATE_TICKS) __asm__ volatile ("hlt");
+    uint64_t cycles = rdtsc() - tsc_start;
+    
+    // cycles / (ticks * divisor / PIT_BASE_HZ) seconds, in kHz
+    tsc_rate_khz = (uint32_t)div64_32(cycles * PIT_BASE_HZ,
+                                      TSC_CALIBRATE_TICKS * tick_divisor * 1000);
+    printf_serial("TSC running at %u.%u MHz\n", tsc_rate_khz / 1000, (tsc_rate_khz % 1000) / 100);
+}
+
+uint32_t tsc_khz(void) {
+    return tsc_rate_khz;
+}
+
+// Saturates at about 71 minutes
+uint32_t tsc_to_us(uint64_t cycles) {
+    uint32_t khz = tsc_rate_khz ? tsc_rate_khz : 1000000;
+    uint64_t us = div64_32(cycles * 1000, khz);
+    return us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)us;
+}
@@ -0,0 +1,24 @@
+/* pit.h - 8253/8254 programmable interval timer */
+#ifndef PIT_H
+#define PIT_H
+
+#include "types.h"
+
+#define PIT_BASE_HZ   1193182  // Input clock of every PIT channel
+#define PIT_CHANNEL0  0x40
+#define PIT_COMMAND   0x43
+
+#define TIMER_HZ      100      // Default tick rate (IRQ0 frequency)
+
+#define TSC_CALIBRATE_TICKS 10  // PIT ticks the TSC calibration runs for
+
+void pit_init(uint32_t hz);
+uint32_t pit_hz(void);
+
+// Time-stamp counter rate, measured against the PIT. Until tsc_calibrate
+// has run, tsc_khz is 0 and tsc_to_us assumes 1 GHz.
+void tsc_calibrate(void);
+uint32_t tsc_khz(void);
+uint32_t tsc_to_us(uint64_t cycles);
+
+#endif
@@ -1,310 +1,803 @@
-// process.c
-#include "process.h"
-#include "memory.h"
-#include "io.h"
-#include "types.h"
-
-static pcb_t process_table[MAX_PROCESSES];
-static int next_pid = INIT_PID;
-static int current_pid = NULL_PID;
-static int process_count = 0;
-
-// Message queue for IPC (bonus)
-typedef struct message {
-    int from_pid;
-    int to_pid;
-    uint32_t size;
-    void* data;
-    struct message* next;
-} message_t;
-
-static message_t* message_queue = NULL;
-
-// Initialize process manager
-void process_manager_init(void) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        process_table[i].pid = -1;
-        process_table[i].state = TERMINATED;
-        process_table[i].next = NULL;
-    }
-    
-    // Create initial null/init process
-    process_table[0].pid = NULL_PID;
-    process_table[0].state = CURRENT;
-    process_table[0].priority = 0;
-    process_table[0].cpu_time = 0;
-    process_table[0].next = NULL;
-    const char* null_name = "null_process";
-    for (int j = 0; null_name[j] && j < 31; j++) {
-        ((char*)&process_table[0].page_directory)[j] = null_name[j];
-    }
-    
-    current_pid = NULL_PID;
-    process_count = 1;
-    next_pid = INIT_PID;
-    
-    printf_serial("Process manager initialized\n");
-}
-
-// Create a new process
-int create_process(void (*entry_point)(void), const char* name) {
-    if (process_count >= MAX_PROCESSES) {
-        printf_serial("Error: Maximum process limit reached\n");
-        return -1;
-    }
-    
-    // Find free slot
-    int slot = -1;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].state == TERMINATED || process_table[i].pid == -1) {
-            slot = i;
-            break;
-        }
-    }
-    
-    if (slot == -1) {
-        printf_serial("Error: No free PCB slots\n");
-        return -1;
-    }
-    
-    // Allocate stack
-    uint32_t stack_top = allocate_stack(next_pid);
-    if (!stack_top) {
-        printf_serial("Error: Failed to allocate stack for new process\n");
-        return -1;
-    }
-    
-    // Initialize PCB
-    process_table[slot].pid = next_pid;
-    process_table[slot].state = READY;
-    process_table[slot].program_counter = (uint32_t)entry_point;
-    process_table[slot].stack_pointer = stack_top;
-    process_table[slot].stack_base = stack_top - STACK_SIZE;
-    process_table[slot].priority = 1;  // Default priority
-    process_table[slot].cpu_time = 0;
-    process_table[slot].next = NULL;
-    
-    // Store process name in page_directory field (repurposed for name storage)
-    const char* name_src = name ? name : "unnamed";
-    int i = 0;
-    while (name_src[i] && i < 31) {
-        ((char*)&process_table[slot].page_directory)[i] = name_src[i];
-        i++;
-    }
-    ((char*)&process_table[slot].page_directory)[i] = '\0';
-    
-    // Initialize stack for context switch
-    // Push initial context onto stack
-    uint32_t* stack = (uint32_t*)stack_top;
-    
-    // Simulated saved registers for context switch
-    // This would be architecture-specific
-    *(--stack) = 0x10;  // EFLAGS
-    *(--stack) = 0x08;  // CS
-    *(--stack) = (uint32_t)entry_point;  // EIP
-    *(--stack) = 0;  // EAX
-    *(--stack) = 0;  // ECX
-    *(--stack) = 0;  // EDX
-    *(--stack) = 0;  // EBX
-    --stack;
-    *stack = (uint32_t)stack;  // ESP
-    *(--stack) = 0;  // EBP
-    *(--stack) = 0;  // ESI
-    *(--stack) = 0;  // EDI
-    
-    process_table[slot].stack_pointer = (uint32_t)stack;
-    
-    printf_serial("Created process PID %d: %s\n", next_pid, name);
-    
-    process_count++;
-    return next_pid++;
-}
-
-// Terminate a process
-void terminate_process(int pid) {
-    if (pid == NULL_PID) {
-        printf_serial("Error: Cannot terminate null process\n");
-        return;
-    }
-    
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].pid == pid) {
-            // Free allocated memory
-            free_stack(pid);
-            
-            // Clean up IPC messages (bonus)
-            message_t* msg = message_queue;
-            message_t* prev = NULL;
-            while (msg) {
-                if (msg->from_pid == pid || msg->to_pid == pid) {
-                    if (prev) {
-                        prev->next = msg->next;
-                    } else {
-                        message_queue = msg->next;
-                    }
-                    // Free message data
-                    kfree(msg->data);
-                    kfree(msg);
-                    msg = prev ? prev->next : message_queue;
-                } else {
-                    prev = msg;
-                    msg = msg->next;
-                }
-            }
-            
-            // Mark PCB as free
-            process_table[i].state = TERMINATED;
-            process_table[i].pid = -1;
-            process_count--;
-            
-            printf_serial("Terminated process PID %d\n", pid);
-            return;
-        }
-    }
-    
-    printf_serial("Error: Process PID %d not found\n", pid);
-}
-
-// Change process state
-void set_process_state(int pid, process_state_t state) {
-    pcb_t* proc = get_process(pid);
-    if (proc) {
-        process_state_t old_state = proc->state;
-        proc->state = state;
-        printf_serial("PID %d: %d -> %d\n", pid, old_state, state);
-        
-        if (state == CURRENT) {
-            current_pid = pid;
-        }
-    }
-}
-
-// Get PCB by PID
-pcb_t* get_process(int pid) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].pid == pid) {
-            return &process_table[i];
-        }
-    }
-    return NULL;
-}
-
-// Get process state
-process_state_t get_process_state(int pid) {
-    pcb_t* proc = get_process(pid);
-    return proc ? proc->state : TERMINATED;
-}
-
-// List all processes
-void list_processes(void) {
-    printf_serial("=== Process List (%d active) ===\n", process_count);
-    printf_serial("PID\tState\t\tPC\t\tSP\t\tCPU Time\n");
-    printf_serial("---\t-----\t\t---\t\t---\t\t--------\n");
-    
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].state != TERMINATED && process_table[i].pid != -1) {
-            const char* state_str;
-            switch (process_table[i].state) {
-                case TERMINATED: state_str = "TERMINATED"; break;
-                case READY: state_str = "READY"; break;
-                case CURRENT: state_str = "CURRENT"; break;
-                case BLOCKED: state_str = "BLOCKED"; break;
-                case SUSPENDED: state_str = "SUSPENDED"; break;
-                default: state_str = "UNKNOWN";
-            }
-            
-            printf_serial("%d\t%s\t0x%x\t0x%x\t%u\n",
-                process_table[i].pid,
-                state_str,
-                process_table[i].program_counter,
-                process_table[i].stack_pointer,
-                process_table[i].cpu_time);
-        }
-    }
-}
-
-// Utility functions
-int get_current_pid(void) {
-    return current_pid;
-}
-
-pcb_t* get_current_process(void) {
-    return get_process(current_pid);
-}
-
-int get_next_pid(void) {
-    return next_pid;
-}
-
-// Bonus: IPC implementation
-void send_message(int to_pid, void* msg, uint32_t size) {
-    if (!msg || size == 0) return;
-    
-    // Check if destination process exists
-    pcb_t* dest = get_process(to_pid);
-    if (!dest || dest->state == TERMINATED) {
-        printf_serial("Error: Destination process %d not found\n", to_pid);
-        return;
-    }
-    
-    // Allocate message
-    message_t* new_msg = (message_t*)kmalloc(sizeof(message_t));
-    if (!new_msg) return;
-    
-    // Allocate message data
-    new_msg->data = kmalloc(size);
-    if (!new_msg->data) {
-        kfree(new_msg);
-        return;
-    }
-    
-    // Copy message data
-    memcpy(new_msg->data, msg, size);
-    
-    // Set message metadata
-    new_msg->from_pid = current_pid;
-    new_msg->to_pid = to_pid;
-    new_msg->size = size;
-    new_msg->next = NULL;
-    
-    // Add to queue
-    if (!message_queue) {
-        message_queue = new_msg;
-    } else {
-        message_t* last = message_queue;
-        while (last->next) last = last->next;
-        last->next = new_msg;
-    }
-    
-    printf_serial("Message sent from PID %d to PID %d\n", current_pid, to_pid);
-}
-
-void* receive_message(int* from_pid) {
-    pcb_t* current = get_current_process();
-    if (!current) return NULL;
-    
-    // Find first message for current process
-    message_t* msg = message_queue;
-    message_t* prev = NULL;
-    
-    while (msg) {
-        if (msg->to_pid == current->pid) {
-            // Remove from queue
-            if (prev) {
-                prev->next = msg->next;
-            } else {
-                message_queue = msg->next;
-            }
-            
-            // Return message data
-            if (from_pid) *from_pid = msg->from_pid;
-            void* data = msg->data;
-            kfree(msg);
-            return data;
-        }
-        prev = msg;
-        msg = msg->next;
-    }
-    
-    return NULL;
-}
\ No newline at end of file
+// process.c
+#include "process.h"
+#include "memory.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "sync.h"
+#include "log.h"
+#include "pit.h"
+#include "io.h"
+#include "types.h"
+
+static pcb_t process_table[MAX_PROCESSES];
+static int next_pid = INIT_PID;
+static int process_count = 0;
+static int reap_slot = -1;  // Exited process whose stack is still in use
+
+static int mailbox_init(pcb_t* proc, uint32_t capacity);
+static void ipc_abort(pcb_t* proc);
+static void init_idle_slot(pcb_t* proc, int pid, const char* name);
+static void reset_times(pcb_t* proc);
+
+// Initialize process manager
+void process_manager_init(void) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        process_table[i].pid = -1;
+        process_table[i].state = TERMINATED;
+        process_table[i].wait_reason = WAIT_NONE;
+        process_table[i].next = NULL;
+        process_table[i].prev = NULL;
+        process_table[i].rq_level = -1;
+        process_table[i].wait_next = NULL;
+        process_table[i].wait_queue = NULL;
+        process_table[i].sem_unit = NULL;
+        process_table[i].timer_next = NULL;
+        process_table[i].timer_prev = NULL;
+        process_table[i].ipc_partner = -1;
+        process_table[i].call_head = NULL;
+        process_table[i].call_tail = NULL;
+        process_table[i].call_next = NULL;
+    }
+    
+    // Create initial null/init process: kmain, the BSP's idle loop
+    init_idle_slot(&process_table[0], NULL_PID, "null_process");
+    
+    process_count = 1;
+    next_pid = INIT_PID;
+    
+    printf_serial("Process manager initialized\n");
+}
+
+// Turn `proc` into the calling CPU's running idle process. It has no stack
+// of its own: it is whatever the CPU was running on when it got here.
+static void init_idle_slot(pcb_t* proc, int pid, const char* name) {
+    proc->pid = pid;
+    proc->state = CURRENT;
+    proc->priority = 0;
+    reset_times(proc);
+    proc->wait_reason = WAIT_NONE;
+    proc->next = NULL;
+    proc->prev = NULL;
+    proc->rq_level = -1;
+    proc->dl_period = 0;
+    proc->cpu = this_cpu()->id;
+    proc->lock_depth = 0;
+    arena_init(&proc->arena, pid);
+    mailbox_init(proc, MAILBOX_DEFAULT_CAPACITY);
+    proc->page_directory = paging_kernel_directory();
+    strcpy(proc->name, name);
+    this_cpu()->current_pid = pid;
+}
+
+// Idle process of an application processor (see smp.c)
+pcb_t* create_idle_process(const char* name) {
+    uint32_t irq = irq_save();
+    pcb_t* idle = NULL;
+    for (int i = 0; i < MAX_PROCESSES && !idle; i++) {
+        if ((process_table[i].state == TERMINATED || process_table[i].pid == -1) && i != reap_slot) {
+            idle = &process_table[i];
+        }
+    }
+    if (idle) {
+        init_idle_slot(idle, next_pid++, name);
+        process_count++;
+    } else {
+        printf_serial("Error: No free PCB slot for %s\n", name);
+    }
+    irq_restore(irq);
+    return idle;
+}
+
+// Create a new process with the default stack size
+int create_process(void (*entry_point)(void), const char* name) {
+    return create_process_with_stack(entry_point, name, STACK_SIZE);
+}
+
+// Create a new process with a stack of at least `stack_size` bytes
+static int do_create_process(void (*entry_point)(void), const char* name, uint32_t stack_size) {
+    if (process_count >= MAX_PROCESSES) {
+        printf_serial("Error: Maximum process limit reached\n");
+        return -1;
+    }
+    
+    // Find free slot
+    int slot = -1;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if ((process_table[i].state == TERMINATED || process_table[i].pid == -1) && i != reap_slot) {
+            slot = i;
+            break;
+        }
+    }
+    
+    if (slot == -1) {
+        printf_serial("Error: No free PCB slots\n");
+        return -1;
+    }
+    
+    // Allocate stack
+    uint32_t stack_top = allocate_stack(slot, next_pid, stack_size);
+    if (!stack_top) {
+        printf_serial("Error: Failed to allocate stack for new process\n");
+        return -1;
+    }
+    
+    // Initialize PCB
+    process_table[slot].pid = next_pid;
+    process_table[slot].state = READY;
+    process_table[slot].program_counter = (uint32_t)entry_point;
+    process_table[slot].stack_pointer = stack_top;
+    process_table[slot].stack_size = get_stack_size(slot);
+    process_table[slot].stack_base = stack_top - process_table[slot].stack_size;
+    process_table[slot].priority = 1;  // Default priority
+    reset_times(&process_table[slot]);
+    process_table[slot].wait_reason = WAIT_NONE;
+    process_table[slot].next = NULL;
+    process_table[slot].prev = NULL;
+    process_table[slot].rq_level = -1;
+    process_table[slot].vruntime = 0;
+    process_table[slot].weight = 0;
+    process_table[slot].mlfq_level = 0;   // Epoch 0 is stale: starts on top
+    process_table[slot].mlfq_used = 0;
+    process_table[slot].mlfq_epoch = 0;
+    process_table[slot].dl_runtime = 0;
+    process_table[slot].dl_deadline = 0;
+    process_table[slot].dl_period = 0;
+    process_table[slot].dl_misses = 0;
+    process_table[slot].cpu = 0;
+    process_table[slot].lock_depth = 0;  // First run starts outside the kernel lock
+    process_table[slot].kill_pending = 0;
+    process_table[slot].wait_next = NULL;
+    process_table[slot].wait_queue = NULL;
+    process_table[slot].sem_unit = NULL;
+    process_table[slot].timer_next = NULL;
+    process_table[slot].timer_prev = NULL;
+    process_table[slot].ipc_partner = -1;
+    process_table[slot].call_head = NULL;
+    process_table[slot].call_tail = NULL;
+    process_table[slot].call_next = NULL;
+    arena_init(&process_table[slot].arena, next_pid);
+    if (!mailbox_init(&process_table[slot], MAILBOX_DEFAULT_CAPACITY)) {
+        arena_release(&process_table[slot].arena);
+        free_stack(slot);
+        return -1;
+    }
+    
+    process_table[slot].page_directory = paging_kernel_directory();
+    
+    const char* name_src = name ? name : "unnamed";
+    int i = 0;
+    while (name_src[i] && i < PROCESS_NAME_LEN - 1) {
+        process_table[slot].name[i] = name_src[i];
+        i++;
+    }
+    process_table[slot].name[i] = '\0';
+    
+    // Initial frame for switch_stacks: the first switch into this process
+    // "returns" to process_start, which calls the entry point from EBX
+    uint32_t* stack = (uint32_t*)stack_top;
+    *(--stack) = (uint32_t)process_start;  // Return address
+    *(--stack) = 0;  // EBP
+    *(--stack) = (uint32_t)entry_point;  // EBX
+    *(--stack) = 0;  // ESI
+    *(--stack) = 0;  // EDI
+    *(--stack) = 0x002;  // EFLAGS
+    
+    process_table[slot].stack_pointer = (uint32_t)stack;
+    
+    printf_serial("Created process PID %d: %s\n", next_pid, name);
+    
+    process_count++;
+    return next_pid++;
+}
+
+int create_process_with_stack(void (*entry_point)(void), const char* name, uint32_t stack_size) {
+    uint32_t irq = irq_save();
+    int pid = do_create_process(entry_point, name, stack_size);
+    irq_restore(irq);
+    return pid;
+}
+
+// Terminate a process. A process terminating itself does not return: its
+// stack is freed by process_reap once another process is running.
+static void do_terminate_process(int pid) {
+    if (pid == NULL_PID || scheduler_is_idle(get_process(pid))) {
+        printf_serial("Error: Cannot terminate an idle process\n");
+        return;
+    }
+    
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (process_table[i].pid == pid) {
+            // Its stack is in use on another CPU: that CPU ends it instead
+            if (process_table[i].state == CURRENT && pid != get_current_pid()) {
+                process_table[i].kill_pending = 1;
+                return;
+            }
+            
+            scheduler_remove(&process_table[i]);
+            ipc_abort(&process_table[i]);
+            sync_abort(&process_table[i]);
+            
+            // Free allocated memory
+            int self = (pid == get_current_pid());
+            if (self) {
+                reap_slot = i;
+            } else {
+                free_stack(i);
+            }
+            
+            // Every payload still queued in the mailbox (copied or
+            // zero-copy) belongs to the arena and goes with it. Messages
+            // this process already sent stay deliverable.
+            kfree(process_table[i].mailbox.slots);
+            process_table[i].mailbox.slots = NULL;
+            process_table[i].mailbox.count = 0;
+            
+            // Drop everything the process allocated in one sweep
+            arena_release(&process_table[i].arena);
+            
+            // Mark PCB as free
+            process_table[i].state = TERMINATED;
+            process_table[i].pid = -1;
+            process_count--;
+            
+            LOG(PROC, LOG_INFO, LOGMSG_TERMINATED, pid);
+            if (self) {
+                schedule();
+                for (;;) __asm__ volatile ("hlt");  // Never resumed
+            }
+            return;
+        }
+    }
+    
+    printf_serial("Error: Process PID %d not found\n", pid);
+}
+
+void terminate_process(int pid) {
+    uint32_t irq = irq_save();
+    do_terminate_process(pid);
+    irq_restore(irq);
+}
+
+// Free the stack of a process that terminated itself; called on the next
+// process's stack right after the switch away from it
+void process_reap(void) {
+    if (reap_slot >= 0) {
+        free_stack(reap_slot);
+        reap_slot = -1;
+    }
+}
+
+// Where a process lands when its entry point returns
+void process_exit(void) {
+    terminate_process(get_current_pid());
+}
+
+// Start the time accounts of a fresh PCB; its state is already set
+static void reset_times(pcb_t* proc) {
+    proc->state_tsc = rdtsc();
+    proc->run_cycles = 0;
+    proc->ready_cycles = 0;
+    proc->block_cycles = 0;
+    proc->latency_max = 0;
+    memset(proc->latency_hist, 0, sizeof(proc->latency_hist));
+}
+
+// Change the state of `proc`, charging the time since its last change to
+// the state it leaves. A READY-to-CURRENT change is a scheduling latency
+// sample. Moves between run queues stay READY and keep their start time.
+void set_pcb_state(pcb_t* proc, process_state_t state) {
+    if (proc->state == state) return;
+    
+    uint64_t now = rdtsc();
+    uint64_t elapsed = now - proc->state_tsc;
+    if ((int64_t)elapsed < 0) elapsed = 0;  // Migrated to a CPU whose TSC lags
+    
+    switch (proc->state) {
+        case CURRENT:
+            proc->run_cycles += elapsed;
+            break;
+        case READY:
+            proc->ready_cycles += elapsed;
+            if (state == CURRENT) {
+                uint32_t us = tsc_to_us(elapsed);
+                int bucket = us ? 31 - __builtin_clz(us) : 0;
+                if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+                proc->latency_hist[bucket]++;
+                if (us > proc->latency_max) proc->latency_max = us;
+            }
+            break;
+        case BLOCKED:
+        case SUSPENDED:
+            proc->block_cycles += elapsed;
+            break;
+        default:
+            break;
+    }
+    proc->state = state;
+    proc->state_tsc = now;
+}
+
+// Cycles `proc` has spent in `state`, including the stretch it is in now
+uint64_t process_cycles(pcb_t* proc, process_state_t state) {
+    uint64_t total;
+    switch (state) {
+        case CURRENT: total = proc->run_cycles; break;
+        case READY: total = proc->ready_cycles; break;
+        case BLOCKED: case SUSPENDED: total = proc->block_cycles; break;
+        default: return 0;
+    }
+    int live = proc->state == state ||
+               ((state == BLOCKED || state == SUSPENDED) &&
+                (proc->state == BLOCKED || proc->state == SUSPENDED));
+    if (live) {
+        uint64_t elapsed = rdtsc() - proc->state_tsc;
+        if ((int64_t)elapsed > 0) total += elapsed;
+    }
+    return total;
+}
+
+// Change process state
+void set_process_state(int pid, process_state_t state) {
+    pcb_t* proc = get_process(pid);
+    if (proc) {
+        process_state_t old_state = proc->state;
+        set_pcb_state(proc, state);
+        LOG(PROC, LOG_DEBUG, LOGMSG_STATE_CHANGE, pid, old_state, state);
+        
+        if (state == CURRENT) {
+            this_cpu()->current_pid = pid;
+        }
+    }
+}
+
+// Get PCB by PID
+pcb_t* get_process(int pid) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (process_table[i].pid == pid) {
+            return &process_table[i];
+        }
+    }
+    return NULL;
+}
+
+// Live process in PCB slot `slot`, or NULL; for walking every process
+pcb_t* get_process_slot(int slot) {
+    if (slot < 0 || slot >= MAX_PROCESSES) return NULL;
+    pcb_t* proc = &process_table[slot];
+    return (proc->pid == -1 || proc->state == TERMINATED) ? NULL : proc;
+}
+
+// Get process state
+process_state_t get_process_state(int pid) {
+    pcb_t* proc = get_process(pid);
+    return proc ? proc->state : TERMINATED;
+}
+
+// List all processes
+void list_processes(void) {
+    printf_serial("=== Process List (%d active) ===\n", process_count);
+    printf_serial("PID\tState\t\tPC\t\tSP\t\tCPU (us)\tUtil\tMax lat (us)\tMem (peak)\tPages\n");
+    printf_serial("---\t-----\t\t---\t\t---\t\t--------\t----\t------------\t----------\t-----\n");
+    
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (process_table[i].state != TERMINATED && process_table[i].pid != -1) {
+            const char* state_str;
+            switch (process_table[i].state) {
+                case TERMINATED: state_str = "TERMINATED"; break;
+                case READY: state_str = "READY"; break;
+                case CURRENT: state_str = "CURRENT"; break;
+                case BLOCKED: state_str = "BLOCKED"; break;
+                case SUSPENDED: state_str = "SUSPENDED"; break;
+                default: state_str = "UNKNOWN";
+            }
+            
+            // Utilization: share of its lifetime so far spent running
+            pcb_t* proc = &process_table[i];
+            uint64_t run = process_cycles(proc, CURRENT);
+            uint64_t life = run + process_cycles(proc, READY) + process_cycles(proc, BLOCKED);
+            uint32_t util = permille(run, life);
+            
+            printf_serial("%d\t%s\t0x%x\t0x%x\t%u\t\t%u.%u%%\t%u\t\t%u (%u)\t%u\n",
+                process_table[i].pid,
+                state_str,
+                process_table[i].program_counter,
+                process_table[i].stack_pointer,
+                tsc_to_us(run),
+                util / 10, util % 10,
+                process_table[i].latency_max,
+                process_table[i].arena.bytes_used,
+                process_table[i].arena.peak_bytes,
+                process_table[i].arena.pages);
+        }
+    }
+}
+
+// Utility functions
+int get_current_pid(void) {
+    return this_cpu()->current_pid;
+}
+
+pcb_t* get_current_process(void) {
+    return get_process(get_current_pid());
+}
+
+int get_next_pid(void) {
+    return next_pid;
+}
+
+// Allocate from the calling process's arena; release with kfree or let
+// process exit drop it
+void* process_alloc(uint32_t size) {
+    pcb_t* current = get_current_process();
+    if (!current) return kmalloc(size);
+    uint32_t irq = irq_save();
+    void* ptr = arena_alloc(&current->arena, size);
+    irq_restore(irq);
+    return ptr;
+}
+
+// Bonus: IPC implementation
+
+static uint32_t mailbox_round_capacity(uint32_t capacity) {
+    uint32_t cap = 1;
+    if (capacity > MAILBOX_MAX_CAPACITY) capacity = MAILBOX_MAX_CAPACITY;
+    while (cap < capacity) cap <<= 1;
+    return cap;
+}
+
+// Give `proc` an empty ring of `capacity` slots (rounded up to a power of
+// two). The ring lives on the kernel heap, not in the arena: as a
+// lifelong allocation there it would keep the arena from ever rewinding.
+static int mailbox_init(pcb_t* proc, uint32_t capacity) {
+    mailbox_t* box = &proc->mailbox;
+    capacity = mailbox_round_capacity(capacity);
+    box->slots = (mailbox_slot_t*)kmalloc(capacity * sizeof(mailbox_slot_t));
+    if (!box->slots) {
+        box->capacity = 0;
+        return 0;
+    }
+    box->capacity = capacity;
+    box->head = 0;
+    box->count = 0;
+    box->policy = MAILBOX_REJECT;
+    box->dropped = 0;
+    return 1;
+}
+
+// Slot for a new message in `dest`, applying its overflow policy when the
+// ring is full. NULL means the message must be refused.
+static mailbox_slot_t* mailbox_reserve(pcb_t* dest) {
+    mailbox_t* box = &dest->mailbox;
+    if (box->count == box->capacity) {
+        box->dropped++;
+        if (box->policy == MAILBOX_REJECT || box->capacity == 0) {
+            printf_serial("Error: Mailbox of PID %d full, message rejected\n", dest->pid);
+            return NULL;
+        }
+        mailbox_slot_t* oldest = &box->slots[box->head];
+        if (oldest->data) kfree(oldest->data);
+        box->head = (box->head + 1) & (box->capacity - 1);
+        box->count--;
+    }
+    mailbox_slot_t* slot = &box->slots[(box->head + box->count) & (box->capacity - 1)];
+    box->count++;
+    slot->from_pid = get_current_pid();
+    return slot;
+}
+
+// Change a process's ring size and overflow policy. The capacity can only
+// change while the mailbox is empty; pass 0 to keep it.
+static int do_mailbox_configure(int pid, uint32_t capacity, mailbox_policy_t policy) {
+    pcb_t* proc = get_process(pid);
+    if (!proc || proc->state == TERMINATED) return -1;
+    mailbox_t* box = &proc->mailbox;
+    
+    if (capacity && mailbox_round_capacity(capacity) != box->capacity) {
+        if (box->count) {
+            printf_serial("Error: Mailbox of PID %d not empty, capacity unchanged\n", pid);
+            return -1;
+        }
+        mailbox_slot_t* old = box->slots;
+        uint32_t old_capacity = box->capacity;
+        uint32_t dropped = box->dropped;
+        if (!mailbox_init(proc, capacity)) {
+            box->slots = old;
+            box->capacity = old_capacity;
+            return -1;
+        }
+        box->dropped = dropped;
+        if (old) kfree(old);
+    }
+    box->policy = policy;
+    return 0;
+}
+
+int mailbox_configure(int pid, uint32_t capacity, mailbox_policy_t policy) {
+    uint32_t irq = irq_save();
+    int ret = do_mailbox_configure(pid, capacity, policy);
+    irq_restore(irq);
+    return ret;
+}
+
+// Copy `msg` into `to_pid`'s mailbox. Small payloads go into the ring slot,
+// larger ones into the receiver's arena. Returns 0, or -1 if refused.
+static int do_send_message(int to_pid, void* msg, uint32_t size) {
+    if (!msg || size == 0) return -1;
+    
+    // Check if destination process exists
+    pcb_t* dest = get_process(to_pid);
+    if (!dest || dest->state == TERMINATED) {
+        printf_serial("Error: Destination process %d not found\n", to_pid);
+        return -1;
+    }
+    
+    void* data = NULL;
+    if (size > MAILBOX_INLINE_SIZE) {
+        data = arena_alloc(&dest->arena, size);
+        if (!data) return -1;
+        memcpy(data, msg, size);
+    }
+    
+    mailbox_slot_t* slot = mailbox_reserve(dest);
+    if (!slot) {
+        if (data) kfree(data);
+        return -1;
+    }
+    slot->size = size;
+    slot->data = data;
+    if (!data) memcpy(slot->inline_data, msg, size);
+    if (dest->state == BLOCKED && dest->wait_reason == WAIT_MESSAGE) {
+        wake_process(dest);
+    }
+    
+    LOG(IPC, LOG_DEBUG, LOGMSG_MESSAGE_SENT, get_current_pid(), to_pid);
+    return 0;
+}
+
+int send_message(int to_pid, void* msg, uint32_t size) {
+    uint32_t irq = irq_save();
+    int ret = do_send_message(to_pid, msg, size);
+    irq_restore(irq);
+    return ret;
+}
+
+// Buffer owned by the calling process, to fill and pass to send_message_zc
+void* ipc_buffer(uint32_t size) {
+    pcb_t* current = get_current_process();
+    if (!current) return NULL;
+    uint32_t irq = irq_save();
+    void* buf = ipc_buffer_alloc(&current->arena, size);
+    irq_restore(irq);
+    return buf;
+}
+
+// Hand `buf` (from ipc_buffer, or a zero-copy message this process
+// received) to `to_pid` without copying. On success the sender must not
+// touch it again; returns 0, or -1 if the sender keeps ownership.
+static int do_send_message_zc(int to_pid, void* buf, uint32_t size) {
+    pcb_t* current = get_current_process();
+    pcb_t* dest = get_process(to_pid);
+    if (!current || !buf || size == 0 || size > ipc_buffer_size(buf)) return -1;
+    if (!dest || dest->state == TERMINATED) {
+        printf_serial("Error: Destination process %d not found\n", to_pid);
+        return -1;
+    }
+    if (!ipc_buffer_give(buf, &current->arena, &dest->arena)) {
+        printf_serial("Error: PID %d does not own IPC buffer 0x%x\n", get_current_pid(), buf);
+        return -1;
+    }
+    
+    mailbox_slot_t* slot = mailbox_reserve(dest);
+    if (!slot) {
+        ipc_buffer_give(buf, &dest->arena, &current->arena);
+        return -1;
+    }
+    slot->size = size;
+    slot->data = buf;
+    if (dest->state == BLOCKED && dest->wait_reason == WAIT_MESSAGE) {
+        wake_process(dest);
+    }
+    LOG(IPC, LOG_DEBUG, LOGMSG_MESSAGE_HANDED, get_current_pid(), to_pid, size);
+    return 0;
+}
+
+int send_message_zc(int to_pid, void* buf, uint32_t size) {
+    uint32_t irq = irq_save();
+    int ret = do_send_message_zc(to_pid, buf, size);
+    irq_restore(irq);
+    return ret;
+}
+
+// Give a received message back, whichever way it was sent. A zero-copy
+// buffer can instead be recycled by passing it on to send_message_zc.
+void release_message(void* data) {
+    pcb_t* current = get_current_process();
+    if (current && data == current->mailbox.last_inline) return;
+    kfree(data);
+}
+
+// Take the oldest message from the caller's mailbox, or NULL if it is
+// empty. Inline payloads are returned in the mailbox's receive buffer and
+// stay valid until the next receive; either way finish with release_message.
+static void* do_receive_message(int* from_pid) {
+    pcb_t* current = get_current_process();
+    if (!current) return NULL;
+    
+    mailbox_t* box = &current->mailbox;
+    if (box->count == 0) return NULL;
+    
+    mailbox_slot_t* slot = &box->slots[box->head];
+    box->head = (box->head + 1) & (box->capacity - 1);
+    box->count--;
+    
+    if (from_pid) *from_pid = slot->from_pid;
+    if (slot->data) return slot->data;
+    memcpy(box->last_inline, slot->inline_data, slot->size);
+    return box->last_inline;
+}
+
+void* receive_message(int* from_pid) {
+    uint32_t irq = irq_save();
+    void* data = do_receive_message(from_pid);
+    irq_restore(irq);
+    return data;
+}
+
+// Like receive_message, but an empty mailbox parks the caller as BLOCKED
+// until a sender wakes it or `timeout_ticks` pass (IPC_WAIT_FOREVER for no
+// limit). Returns NULL on timeout.
+void* receive_message_blocking(int* from_pid, uint32_t timeout_ticks) {
+    pcb_t* current = get_current_process();
+    if (!current) return NULL;
+    
+    // Check and block with interrupts off, or a sender preempting us in
+    // between would find us not yet BLOCKED and never wake us
+    uint32_t irq = irq_save();
+    if (current->mailbox.count == 0 && !scheduler_is_idle(current)) {
+        block_current_process(WAIT_MESSAGE, timeout_ticks);
+    }
+    void* data = do_receive_message(from_pid);
+    irq_restore(irq);
+    return data;
+}
+
+// Synchronous rendezvous IPC (L4-style call/reply). The message is copied
+// PCB to PCB and the CPU goes straight to the blocked partner, so a round
+// trip costs two context switches and never goes through pick_next_process.
+
+static void call_queue_push(pcb_t* server, pcb_t* caller) {
+    caller->call_next = NULL;
+    if (server->call_tail) server->call_tail->call_next = caller;
+    else server->call_head = caller;
+    server->call_tail = caller;
+}
+
+static pcb_t* call_queue_pop(pcb_t* server) {
+    pcb_t* caller = server->call_head;
+    if (caller) {
+        server->call_head = caller->call_next;
+        if (!server->call_head) server->call_tail = NULL;
+        caller->call_next = NULL;
+    }
+    return caller;
+}
+
+static void call_queue_remove(pcb_t* server, pcb_t* caller) {
+    pcb_t* prev = NULL;
+    for (pcb_t* p = server->call_head; p; prev = p, p = p->call_next) {
+        if (p != caller) continue;
+        if (prev) prev->call_next = p->call_next;
+        else server->call_head = p->call_next;
+        if (server->call_tail == p) server->call_tail = prev;
+        p->call_next = NULL;
+        return;
+    }
+}
+
+// Fail every rendezvous that involves a process that is going away
+static void ipc_abort(pcb_t* proc) {
+    if (proc->state == BLOCKED && proc->wait_reason == WAIT_SEND) {
+        pcb_t* server = get_process(proc->ipc_partner);
+        if (server) call_queue_remove(server, proc);
+    }
+    
+    pcb_t* caller;
+    while ((caller = call_queue_pop(proc))) {
+        caller->ipc_partner = -1;
+        wake_process(caller);
+    }
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* p = &process_table[i];
+        if (p->state == BLOCKED && p->wait_reason == WAIT_REPLY && p->ipc_partner == proc->pid) {
+            p->ipc_partner = -1;
+            wake_process(p);
+        }
+    }
+}
+
+// Send `msg` to server `pid` and wait for its reply, which overwrites
+// `msg`. Returns 0, or -1 if the server is gone or died before replying.
+static int do_ipc_call(int pid, ipc_msg_t* msg) {
+    pcb_t* self = get_current_process();
+    pcb_t* server = get_process(pid);
+    if (!self || !msg || scheduler_is_idle(self)) return -1;
+    if (!server || server == self || server->state == TERMINATED) {
+        printf_serial("Error: IPC server %d not found\n", pid);
+        return -1;
+    }
+    
+    self->ipc_msg = *msg;
+    self->ipc_partner = server->pid;
+    if (server->state == BLOCKED && server->wait_reason == WAIT_CALL) {
+        server->ipc_msg = *msg;
+        server->ipc_partner = self->pid;
+        block_and_handoff(WAIT_REPLY, server);
+    } else {
+        // Server busy: queue up; ipc_reply_wait picks us up in order
+        call_queue_push(server, self);
+        block_current_process(WAIT_SEND, IPC_WAIT_FOREVER);
+    }
+    
+    // Resumed by the reply (or by the server's exit)
+    if (self->ipc_partner < 0) return -1;
+    *msg = self->ipc_msg;
+    return 0;
+}
+
+int ipc_call(int pid, ipc_msg_t* msg) {
+    uint32_t irq = irq_save();
+    int ret = do_ipc_call(pid, msg);
+    irq_restore(irq);
+    return ret;
+}
+
+// Server loop step: reply `msg` to `reply_to` (NULL_PID for none), then
+// wait for the next call, whose message overwrites `msg`. Returns the
+// caller's PID, to pass back as `reply_to`, or -1.
+static int do_ipc_reply_wait(int reply_to, ipc_msg_t* msg) {
+    pcb_t* self = get_current_process();
+    if (!self || !msg || scheduler_is_idle(self)) return -1;
+    
+    pcb_t* client = NULL;
+    if (reply_to != NULL_PID) {
+        client = get_process(reply_to);
+        if (client && client->state == BLOCKED && client->wait_reason == WAIT_REPLY &&
+            client->ipc_partner == self->pid) {
+            client->ipc_msg = *msg;
+        } else {
+            printf_serial("Error: PID %d is not waiting for a reply from PID %d\n",
+                          reply_to, self->pid);
+            client = NULL;
+        }
+    }
+    
+    // A caller is already queued: take its message without blocking and
+    // let the replied-to client run when the scheduler gets to it
+    pcb_t* caller = call_queue_pop(self);
+    if (caller) {
+        if (client) wake_process(client);
+        caller->wait_reason = WAIT_REPLY;
+        *msg = caller->ipc_msg;
+        return caller->pid;
+    }
+    
+    self->ipc_partner = -1;
+    if (client) {
+        block_and_handoff(WAIT_CALL, client);
+    } else {
+        block_current_process(WAIT_CALL, IPC_WAIT_FOREVER);
+    }
+    
+    // Resumed by ipc_call, which left its message in our PCB
+    if (self->ipc_partner < 0) return -1;
+    *msg = self->ipc_msg;
+    return self->ipc_partner;
+}
+
+int ipc_reply_wait(int reply_to, ipc_msg_t* msg) {
+    uint32_t irq = irq_save();
+    int ret = do_ipc_reply_wait(reply_to, msg);
+    irq_restore(irq);
+    return ret;
+}
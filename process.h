@@ -1,50 +1,171 @@
-// process.h
-#ifndef PROCESS_H
-#define PROCESS_H
-
-#include "types.h"
-
-#define MAX_PROCESSES 32
-#define NULL_PID 0
-#define INIT_PID 1
-
-// Process states
-typedef enum {
-    TERMINATED = 0,
-    READY,
-    CURRENT,
-    // Bonus states (for bonus points)
-    BLOCKED,
-    SUSPENDED
-} process_state_t;
-
-// Process Control Block (PCB)
-typedef struct pcb {
-    int pid;
-    process_state_t state;
-    uint32_t program_counter;
-    uint32_t stack_pointer;
-    uint32_t stack_base;
-    uint32_t* page_directory;  // For future MMU support
-    int priority;              // For scheduling
-    uint32_t cpu_time;         // Total CPU time used
-    struct pcb* next;          // For linked list in scheduler
-} pcb_t;
-
-// Process Manager API
-void process_manager_init(void);
-int create_process(void (*entry_point)(void), const char* name);
-void terminate_process(int pid);
-void set_process_state(int pid, process_state_t state);
-pcb_t* get_process(int pid);
-process_state_t get_process_state(int pid);
-void list_processes(void);
-int get_current_pid(void);
-pcb_t* get_current_process(void);
-int get_next_pid(void);
-
-// Bonus: IPC functions
-void send_message(int to_pid, void* msg, uint32_t size);
-void* receive_message(int* from_pid);
-
+// process.h
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "types.h"
+#include "memory.h"
+#include "rbtree.h"
+
+#define MAX_PROCESSES 32
+#define PROCESS_NAME_LEN 32
+#define NULL_PID 0
+#define INIT_PID 1
+#define LATENCY_BUCKETS 16  // log2 microsecond buckets, the last one open-ended
+
+// Process states
+typedef enum {
+    TERMINATED = 0,
+    READY,
+    CURRENT,
+    // Bonus states (for bonus points)
+    BLOCKED,
+    SUSPENDED
+} process_state_t;
+
+// Why a BLOCKED process is waiting
+typedef enum {
+    WAIT_NONE = 0,
+    WAIT_MESSAGE,               // receive_message_blocking on an empty mailbox
+    WAIT_CALL,                  // ipc_reply_wait: server waiting for a caller
+    WAIT_SEND,                  // ipc_call: queued until the server is ready
+    WAIT_REPLY,                 // ipc_call: waiting for the server's reply
+    WAIT_PERIOD,                // SCHED_DEADLINE: job done, waiting for the next release
+    WAIT_THROTTLED,             // SCHED_DEADLINE: budget used up before the deadline
+    WAIT_MUTEX,                 // mutex_lock on a held mutex (sync.c)
+    WAIT_SEMAPHORE,             // semaphore_wait at zero
+    WAIT_INPUT,                 // serial_read/serial_readline with no input (io.c)
+    WAIT_SLEEP                  // Timed sleep with nothing to wake it early
+} wait_reason_t;
+
+// Rendezvous message for ipc_call/ipc_reply_wait, carried in the PCB
+#define IPC_MSG_WORDS 4
+
+typedef struct {
+    uint32_t w[IPC_MSG_WORDS];
+} ipc_msg_t;
+
+#define IPC_WAIT_FOREVER 0      // Timeout value for an untimed wait
+
+// IPC mailbox: a bounded ring per process. Payloads up to
+// MAILBOX_INLINE_SIZE bytes are copied into the slot itself; larger ones
+// live in the receiver's arena (or are a zero-copy buffer it now owns).
+#define MAILBOX_INLINE_SIZE      64
+#define MAILBOX_DEFAULT_CAPACITY 16
+#define MAILBOX_MAX_CAPACITY     256
+
+// What send does when the ring is full
+typedef enum {
+    MAILBOX_REJECT = 0,         // Fail the send, keep queued messages
+    MAILBOX_DROP_OLDEST         // Discard the oldest message to make room
+} mailbox_policy_t;
+
+typedef struct {
+    int from_pid;
+    uint32_t size;
+    void* data;                 // Out-of-line payload, NULL when inline
+    uint8_t inline_data[MAILBOX_INLINE_SIZE];
+} mailbox_slot_t;
+
+typedef struct {
+    mailbox_slot_t* slots;      // Ring storage on the kernel heap
+    uint32_t capacity;          // Power of two
+    uint32_t head;              // Next slot to receive from
+    uint32_t count;
+    mailbox_policy_t policy;
+    uint32_t dropped;           // Messages lost to overflow
+    uint8_t last_inline[MAILBOX_INLINE_SIZE];  // Last inline message received
+} mailbox_t;
+
+// Process Control Block (PCB)
+typedef struct pcb {
+    int pid;
+    process_state_t state;
+    uint32_t program_counter;
+    uint32_t stack_pointer;
+    uint32_t stack_base;
+    uint32_t stack_size;
+    uint32_t* page_directory;  // Address space (shared kernel directory)
+    char name[PROCESS_NAME_LEN];
+    int priority;              // For scheduling
+    uint64_t state_tsc;        // TSC when it entered its current state
+    uint64_t run_cycles;       // TSC cycles spent CURRENT,
+    uint64_t ready_cycles;     // ... queued READY
+    uint64_t block_cycles;     // ... and BLOCKED or SUSPENDED
+    uint32_t latency_max;      // Longest READY-to-CURRENT wait, in microseconds
+    uint32_t latency_hist[LATENCY_BUCKETS]; // Those waits by log2 us; 0 also takes <1 us
+    arena_t arena;             // Per-process allocations, dropped on exit
+    mailbox_t mailbox;         // Incoming IPC messages
+    wait_reason_t wait_reason; // Set while BLOCKED
+    ipc_msg_t ipc_msg;         // Rendezvous message being delivered
+    int ipc_partner;           // Server (caller side) or caller (server side), -1 if aborted
+    struct pcb* call_head;     // Callers queued on this server
+    struct pcb* call_tail;
+    struct pcb* call_next;
+    uint32_t wake_tick;        // Timeout deadline while on the sleep list
+    struct pcb* next;          // Run-queue links
+    struct pcb* prev;
+    int rq_level;              // Run-queue level while queued, -1 otherwise
+    uint64_t vruntime;         // SCHED_FAIR: weighted CPU time
+    uint32_t weight;           // SCHED_FAIR: load weight while queued
+    rb_node_t fair_node;       // SCHED_FAIR: position in the vruntime tree
+    int mlfq_level;            // SCHED_MLFQ: current level, 0 is lowest
+    uint32_t mlfq_used;        // SCHED_MLFQ: ticks used of this level's allotment
+    uint32_t mlfq_epoch;       // SCHED_MLFQ: boost epoch the level belongs to
+    uint32_t dl_runtime;       // SCHED_DEADLINE: budget per period, 0 if best-effort
+    uint32_t dl_deadline;      // SCHED_DEADLINE: relative deadline
+    uint32_t dl_period;
+    uint32_t dl_remaining;     // SCHED_DEADLINE: budget left for the current job
+    uint32_t dl_abs_deadline;  // SCHED_DEADLINE: tick the current job is due by
+    uint32_t dl_next_release;  // SCHED_DEADLINE: tick the next job is released
+    int dl_job_active;         // SCHED_DEADLINE: current job not yet completed
+    uint32_t dl_misses;
+    rb_node_t dl_node;         // SCHED_DEADLINE: position in the deadline tree
+    int cpu;                   // CPU whose run queue holds it, or that last ran it
+    uint32_t lock_depth;       // Big kernel lock nesting while switched out (smp.c)
+    int kill_pending;          // Terminate at its next tick (running on another CPU)
+    struct pcb* wait_next;     // Lock wait queue links (sync.c)
+    struct wait_queue* wait_queue; // ... and the queue it sleeps on, NULL if none
+    struct semaphore* sem_unit;    // Semaphore unit handed over but not yet taken (sync.c)
+    struct pcb* timer_next;    // Sleep list, ordered by wake_tick
+    struct pcb* timer_prev;
+} pcb_t;
+
+// First-run trampoline (switch.S)
+extern void process_start(void);
+
+// Process Manager API
+void process_manager_init(void);
+int create_process(void (*entry_point)(void), const char* name);
+int create_process_with_stack(void (*entry_point)(void), const char* name, uint32_t stack_size);
+void terminate_process(int pid);
+void process_exit(void);
+void process_reap(void);
+void set_process_state(int pid, process_state_t state);
+void set_pcb_state(pcb_t* proc, process_state_t state);
+uint64_t process_cycles(pcb_t* proc, process_state_t state);
+pcb_t* get_process(int pid);
+pcb_t* get_process_slot(int slot);
+pcb_t* create_idle_process(const char* name);
+process_state_t get_process_state(int pid);
+void list_processes(void);
+int get_current_pid(void);
+pcb_t* get_current_process(void);
+int get_next_pid(void);
+void* process_alloc(uint32_t size);
+
+// Bonus: IPC functions
+int send_message(int to_pid, void* msg, uint32_t size);
+void* receive_message(int* from_pid);
+void* receive_message_blocking(int* from_pid, uint32_t timeout_ticks);
+void release_message(void* data);
+int mailbox_configure(int pid, uint32_t capacity, mailbox_policy_t policy);
+
+// Synchronous rendezvous IPC with direct handoff
+int ipc_call(int pid, ipc_msg_t* msg);
+int ipc_reply_wait(int reply_to, ipc_msg_t* msg);
+
+// Zero-copy IPC: the buffer changes owner instead of being copied
+void* ipc_buffer(uint32_t size);
+int send_message_zc(int to_pid, void* buf, uint32_t size);
+
 #endif
\ No newline at end of file
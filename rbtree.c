@@ -0,0 +1,206 @@
+/* rbtree.c - Intrusive red-black tree */
+#include "rbtree.h"
+
+static void rotate_left(rb_tree_t* tree, rb_node_t* x) {
+    rb_node_t* y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) tree->root = y;
+    else if (x == x->parent->left) x->parent->left = y;
+    else x->parent->right = y;
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_tree_t* tree, rb_node_t* x) {
+    rb_node_t* y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) tree->root = y;
+    else if (x == x->parent->right) x->parent->right = y;
+    else x->parent->left = y;
+    y->right = x;
+    x->parent = y;
+}
+
+static inline int is_red(const rb_node_t* node) {
+    return node && node->color == RB_RED;
+}
+
+void rb_insert(rb_tree_t* tree, rb_node_t* node, rb_less_t less) {
+    rb_node_t* parent = NULL;
+    rb_node_t** link = &tree->root;
+    int leftmost = 1;
+    
+    while (*link) {
+        parent = *link;
+        if (less(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+    if (leftmost) tree->leftmost = node;
+    
+    // Restore the red-black properties
+    while (is_red(node->parent)) {
+        rb_node_t* p = node->parent;
+        rb_node_t* g = p->parent;
+        if (p == g->left) {
+            rb_node_t* uncle = g->right;
+            if (is_red(uncle)) {
+                p->color = uncle->color = RB_BLACK;
+                g->color = RB_RED;
+                node = g;
+                continue;
+            }
+            if (node == p->right) {
+                rotate_left(tree, p);
+                node = p;
+                p = node->parent;
+            }
+            p->color = RB_BLACK;
+            g->color = RB_RED;
+            rotate_right(tree, g);
+        } else {
+            rb_node_t* uncle = g->left;
+            if (is_red(uncle)) {
+                p->color = uncle->color = RB_BLACK;
+                g->color = RB_RED;
+                node = g;
+                continue;
+            }
+            if (node == p->left) {
+                rotate_right(tree, p);
+                node = p;
+                p = node->parent;
+            }
+            p->color = RB_BLACK;
+            g->color = RB_RED;
+            rotate_left(tree, g);
+        }
+    }
+    tree->root->color = RB_BLACK;
+}
+
+rb_node_t* rb_next(const rb_node_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) node = node->left;
+        return (rb_node_t*)node;
+    }
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+// Put `v` where `u` was in u's parent
+static void transplant(rb_tree_t* tree, rb_node_t* u, rb_node_t* v) {
+    if (!u->parent) tree->root = v;
+    else if (u == u->parent->left) u->parent->left = v;
+    else u->parent->right = v;
+    if (v) v->parent = u->parent;
+}
+
+void rb_erase(rb_tree_t* tree, rb_node_t* node) {
+    if (tree->leftmost == node) tree->leftmost = rb_next(node);
+    
+    // x replaces the removed position; x_parent tracks it when x is NULL
+    rb_node_t* x;
+    rb_node_t* x_parent;
+    int removed_color = node->color;
+    
+    if (!node->left) {
+        x = node->right;
+        x_parent = node->parent;
+        transplant(tree, node, node->right);
+    } else if (!node->right) {
+        x = node->left;
+        x_parent = node->parent;
+        transplant(tree, node, node->left);
+    } else {
+        rb_node_t* y = node->right;
+        while (y->left) y = y->left;
+        removed_color = y->color;
+        x = y->right;
+        if (y->parent == node) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            transplant(tree, y, y->right);
+            y->right = node->right;
+            y->right->parent = y;
+        }
+        transplant(tree, node, y);
+        y->left = node->left;
+        y->left->parent = y;
+        y->color = node->color;
+    }
+    
+    if (removed_color == RB_RED) return;
+    
+    // Removing a black node left one path short; push the extra black up
+    while (x != tree->root && !is_red(x)) {
+        if (x == x_parent->left) {
+            rb_node_t* w = x_parent->right;
+            if (is_red(w)) {
+                w->color = RB_BLACK;
+                x_parent->color = RB_RED;
+                rotate_left(tree, x_parent);
+                w = x_parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->color = RB_RED;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!is_red(w->right)) {
+                    w->left->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_right(tree, w);
+                    w = x_parent->right;
+                }
+                w->color = x_parent->color;
+                x_parent->color = RB_BLACK;
+                if (w->right) w->right->color = RB_BLACK;
+                rotate_left(tree, x_parent);
+                x = tree->root;
+            }
+        } else {
+            rb_node_t* w = x_parent->left;
+            if (is_red(w)) {
+                w->color = RB_BLACK;
+                x_parent->color = RB_RED;
+                rotate_right(tree, x_parent);
+                w = x_parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->color = RB_RED;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!is_red(w->left)) {
+                    w->right->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rotate_left(tree, w);
+                    w = x_parent->left;
+                }
+                w->color = x_parent->color;
+                x_parent->color = RB_BLACK;
+                if (w->left) w->left->color = RB_BLACK;
+                rotate_right(tree, x_parent);
+                x = tree->root;
+            }
+        }
+    }
+    if (x) x->color = RB_BLACK;
+}
@@ -0,0 +1,39 @@
+/* rbtree.h - Intrusive red-black tree */
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include "types.h"
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+// Embedded in the object being indexed; rb_entry gets the object back
+typedef struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    int color;
+} rb_node_t;
+
+// Tree root plus a cached leftmost node, so the minimum is O(1)
+typedef struct {
+    rb_node_t* root;
+    rb_node_t* leftmost;
+} rb_tree_t;
+
+// Strict ordering: nonzero when `a` sorts before `b`. Equal keys go to the
+// right, so nodes with the same key come out in insertion order.
+typedef int (*rb_less_t)(const rb_node_t* a, const rb_node_t* b);
+
+#define rb_entry(node, type, member) \
+    ((type*)((char*)(node) - __builtin_offsetof(type, member)))
+
+void rb_insert(rb_tree_t* tree, rb_node_t* node, rb_less_t less);
+void rb_erase(rb_tree_t* tree, rb_node_t* node);
+rb_node_t* rb_next(const rb_node_t* node);
+
+static inline rb_node_t* rb_first(const rb_tree_t* tree) {
+    return tree->leftmost;
+}
+
+#endif
@@ -1,250 +1,871 @@
-// scheduler.c
-#include "scheduler.h"
-#include "memory.h"
-#include "io.h"
-
-static pcb_t* ready_queue = NULL;
-static sched_config_t config;
-static uint32_t timer_ticks = 0;
-static uint32_t current_tick = 0;
-static uint32_t context_switches = 0;
-static pcb_t* idle_process = NULL;
-
-// Initialize scheduler
-void scheduler_init(sched_policy_t policy, uint32_t quantum) {
-    config.policy = policy;
-    config.time_quantum = quantum;
-    config.aging_enabled = 0;
-    config.max_priority = 10;
-    
-    ready_queue = NULL;
-    timer_ticks = 0;
-    current_tick = 0;
-    context_switches = 0;
-    
-    // Create idle process if no processes are ready
-    idle_process = get_process(NULL_PID);
-    
-    printf_serial("Scheduler initialized with ");
-    switch (policy) {
-        case SCHED_ROUND_ROBIN:
-            printf_serial("Round Robin (quantum: %u)\n", quantum);
-            break;
-        case SCHED_PRIORITY:
-            printf_serial("Priority Scheduling\n");
-            break;
-        case SCHED_FCFS:
-            printf_serial("FCFS\n");
-            break;
-    }
-}
-
-// Main scheduling function
-void schedule(void) {
-    pcb_t* current = get_current_process();
-    pcb_t* next = pick_next_process();
-    
-    if (!next) {
-        // No process in ready queue, run idle
-        next = idle_process;
-    }
-    
-    if (current != next) {
-        context_switch(next);
-    }
-}
-
-// Context switch (simplified - actual implementation needs assembly)
-void context_switch(pcb_t* next) {
-    pcb_t* current = get_current_process();
-    
-    if (current == next) return;
-    
-    printf_serial("Context switch: PID %d -> PID %d\n", 
-                 current ? current->pid : -1, 
-                 next->pid);
-    
-    // Save current process state
-    if (current && current->state == CURRENT) {
-        // In real OS, save registers to current->stack_pointer
-        current->state = READY;
-        add_to_ready_queue(current);
-    }
-    
-    // Update next process
-    next->state = CURRENT;
-    remove_from_ready_queue(next->pid);
-    
-    // Update current PID
-    if (current) {
-        current->cpu_time += current_tick;
-    }
-    current_tick = 0;
-    
-    // In actual implementation:
-    // 1. Save current context to its stack
-    // 2. Load next context from its stack
-    // 3. Switch stacks
-    // 4. Resume execution
-    
-    context_switches++;
-    
-    // For demonstration, just update the current process pointer
-    // In real implementation, this would involve switching stacks and PC
-}
-
-// Add process to ready queue
-void add_to_ready_queue(pcb_t* process) {
-    if (!process || process->state == TERMINATED) return;
-    
-    process->next = NULL;
-    
-    if (!ready_queue) {
-        ready_queue = process;
-    } else {
-        // Add to end of queue (for FCFS/Round Robin)
-        if (config.policy == SCHED_ROUND_ROBIN || config.policy == SCHED_FCFS) {
-            pcb_t* last = ready_queue;
-            while (last->next) last = last->next;
-            last->next = process;
-        }
-        // Insert based on priority (for Priority Scheduling)
-        else if (config.policy == SCHED_PRIORITY) {
-            pcb_t* current = ready_queue;
-            pcb_t* prev = NULL;
-            
-            while (current && current->priority >= process->priority) {
-                prev = current;
-                current = current->next;
-            }
-            
-            if (!prev) {
-                process->next = ready_queue;
-                ready_queue = process;
-            } else {
-                process->next = current;
-                prev->next = process;
-            }
-        }
-    }
-    
-    process->state = READY;
-}
-
-// Remove process from ready queue
-void remove_from_ready_queue(int pid) {
-    if (!ready_queue) return;
-    
-    if (ready_queue->pid == pid) {
-        ready_queue = ready_queue->next;
-        return;
-    }
-    
-    pcb_t* current = ready_queue;
-    pcb_t* prev = NULL;
-    
-    while (current && current->pid != pid) {
-        prev = current;
-        current = current->next;
-    }
-    
-    if (current) {
-        if (prev) prev->next = current->next;
-        current->next = NULL;
-    }
-}
-
-// Pick next process based on scheduling policy
-pcb_t* pick_next_process(void) {
-    if (!ready_queue) return NULL;
-    
-    pcb_t* selected = NULL;
-    
-    switch (config.policy) {
-        case SCHED_ROUND_ROBIN:
-        case SCHED_FCFS:
-            selected = ready_queue;
-            break;
-            
-        case SCHED_PRIORITY:
-            selected = ready_queue;
-            pcb_t* current = ready_queue;
-            while (current) {
-                if (current->priority < selected->priority) {
-                    selected = current;
-                }
-                current = current->next;
-            }
-            break;
-    }
-    
-    // Bonus: Apply aging
-    if (config.aging_enabled) {
-        pcb_t* current = ready_queue;
-        while (current) {
-            if (current != selected && (uint32_t)current->priority < config.max_priority) {
-                current->priority++;  // Increase priority of waiting processes
-            }
-            current = current->next;
-        }
-        // Reset selected process priority
-        if (selected && selected->priority > 1) {
-            selected->priority--;
-        }
-    }
-    
-    return selected;
-}
-
-// Timer interrupt handler (called by timer ISR)
-void timer_tick(void) {
-    timer_ticks++;
-    current_tick++;
-    
-    pcb_t* current = get_current_process();
-    if (current && current->pid != NULL_PID) {
-        // Check if time quantum expired
-        if (config.policy == SCHED_ROUND_ROBIN && 
-            current_tick >= config.time_quantum) {
-            printf_serial("Time quantum expired for PID %d\n", current->pid);
-            schedule();
-        }
-    }
-}
-
-// Change scheduling policy
-void set_scheduling_policy(sched_policy_t policy) {
-    config.policy = policy;
-    printf_serial("Scheduling policy changed\n");
-}
-
-// Change time quantum
-void set_time_quantum(uint32_t quantum) {
-    config.time_quantum = quantum;
-    printf_serial("Time quantum set to %u\n", quantum);
-}
-
-// Enable/disable aging (bonus feature)
-void enable_aging(int enable) {
-    config.aging_enabled = enable;
-    printf_serial("Aging %s\n", enable ? "enabled" : "disabled");
-}
-
-// Display scheduler statistics
-void scheduler_stats(void) {
-    printf_serial("=== Scheduler Statistics ===\n");
-    printf_serial("Total timer ticks: %u\n", timer_ticks);
-    printf_serial("Context switches: %u\n", context_switches);
-    printf_serial("Processes in ready queue: ");
-    
-    int count = 0;
-    pcb_t* current = ready_queue;
-    while (current) {
-        count++;
-        current = current->next;
-    }
-    printf_serial("%d\n", count);
-    
-    printf_serial("Current time quantum: %u\n", config.time_quantum);
-    printf_serial("Aging: %s\n", config.aging_enabled ? "ON" : "OFF");
-}
\ No newline at end of file
+// scheduler.c
+#include "scheduler.h"
+#include "smp.h"
+#include "memory.h"
+#include "paging.h"
+#include "log.h"
+#include "trace.h"
+#include "pit.h"
+#include "io.h"
+
+// Each CPU has its own run queue (smp.h); sleep list, tick count and
+// statistics are global and only touched under irq_save
+static pcb_t* sleep_list = NULL;  // Timed waits, earliest wake_tick first
+static sched_config_t config;
+static uint32_t timer_ticks = 0;         // Advanced by the BSP's PIT only
+static uint32_t context_switches = 0;
+static uint32_t handoffs = 0;
+static uint64_t switch_cycles_total = 0;  // Cost of switch_stacks, measured
+static uint32_t switch_cycles_min = 0xFFFFFFFF;  // from the outgoing side to
+static uint32_t switch_cycles_max = 0;    // the incoming side
+static uint32_t switch_samples = 0;
+static uint32_t mlfq_epoch = 1;           // Bumped by every global boost
+static uint32_t mlfq_boosts = 0;
+static uint32_t mlfq_demotions = 0;
+static uint32_t dl_total_util = 0;        // Admitted SCHED_DEADLINE utilization
+static uint32_t dl_misses = 0;
+static uint32_t dl_throttles = 0;
+
+// Initialize scheduler
+void scheduler_init(sched_policy_t policy, uint32_t quantum) {
+    config.policy = policy;
+    config.time_quantum = quantum;
+    config.aging_enabled = 1;
+    
+    for (int i = 0; i < MAX_CPUS; i++) {
+        runqueue_t* rq = &smp_cpu(i)->rq;
+        memset(rq, 0, sizeof(*rq));
+        rq->cpu = i;
+    }
+    sleep_list = NULL;
+    timer_ticks = 0;
+    this_cpu()->current_tick = 0;
+    context_switches = 0;
+    handoffs = 0;
+    mlfq_epoch = 1;
+    mlfq_boosts = 0;
+    mlfq_demotions = 0;
+    dl_total_util = 0;
+    dl_misses = 0;
+    dl_throttles = 0;
+    
+    // kmain is the BSP's idle process; each AP gets one in scheduler_init_cpu
+    this_cpu()->idle = get_process(NULL_PID);
+    
+    printf_serial("Scheduler initialized with ");
+    switch (policy) {
+        case SCHED_ROUND_ROBIN:
+            printf_serial("Round Robin (quantum: %u)\n", quantum);
+            break;
+        case SCHED_PRIORITY:
+            printf_serial("Priority Scheduling\n");
+            break;
+        case SCHED_FCFS:
+            printf_serial("FCFS\n");
+            break;
+        case SCHED_FAIR:
+            printf_serial("Fair Scheduling (latency: %u ticks)\n", SCHED_FAIR_LATENCY);
+            break;
+        case SCHED_MLFQ:
+            printf_serial("MLFQ (%d levels, boost every %u ticks)\n",
+                          SCHED_MLFQ_LEVELS, SCHED_MLFQ_BOOST_INTERVAL);
+            break;
+    }
+}
+
+// Idle process for an application processor that has just come up: the
+// loop it is already running in
+void scheduler_init_cpu(void) {
+    cpu_t* cpu = this_cpu();
+    char name[] = "idle_cpu0";
+    name[sizeof(name) - 2] = (char)('0' + cpu->id);
+    cpu->idle = create_idle_process(name);
+    cpu->current_tick = 0;
+}
+
+// True for the idle process of any CPU
+int scheduler_is_idle(pcb_t* process) {
+    if (!process) return 0;
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        if (smp_cpu(i)->idle == process) return 1;
+    }
+    return 0;
+}
+
+// Run queue of the calling CPU, and the one a queued process sits on
+static inline runqueue_t* local_rq(void) {
+    return &this_cpu()->rq;
+}
+
+static inline runqueue_t* rq_of(pcb_t* process) {
+    return &smp_cpu(process->cpu)->rq;
+}
+
+// SCHED_FAIR load weight by priority: each step up is worth 25% more CPU
+static const uint32_t fair_weights[16] = {
+    819, 1024, 1280, 1600, 2000, 2500, 3125, 3906,
+    4883, 6104, 7629, 9537, 11921, 14901, 18626, 23283
+};
+
+static uint32_t fair_weight(pcb_t* process) {
+    int prio = process->priority;
+    if (prio < 0) prio = 0;
+    if (prio > 15) prio = 15;
+    return fair_weights[prio];
+}
+
+static int fair_less(const rb_node_t* a, const rb_node_t* b) {
+    const pcb_t* pa = rb_entry(a, pcb_t, fair_node);
+    const pcb_t* pb = rb_entry(b, pcb_t, fair_node);
+    return (int64_t)(pa->vruntime - pb->vruntime) < 0;
+}
+
+// Slice for `process` out of one scheduling period, in proportion to its
+// share of the runnable weight
+static uint32_t fair_slice(runqueue_t* rq, pcb_t* process) {
+    uint32_t weight = fair_weight(process);
+    uint32_t period = SCHED_FAIR_LATENCY;
+    if ((rq->nr_running + 1) * SCHED_FAIR_MIN_GRANULARITY > period) {
+        period = (rq->nr_running + 1) * SCHED_FAIR_MIN_GRANULARITY;
+    }
+    uint32_t slice = (uint32_t)div64_32((uint64_t)period * weight, rq->fair_weight + weight);
+    return slice < SCHED_FAIR_MIN_GRANULARITY ? SCHED_FAIR_MIN_GRANULARITY : slice;
+}
+
+// Tick counts wrap, so deadlines are compared by signed distance
+static inline int tick_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static int dl_less(const rb_node_t* a, const rb_node_t* b) {
+    const pcb_t* pa = rb_entry(a, pcb_t, dl_node);
+    const pcb_t* pb = rb_entry(b, pcb_t, dl_node);
+    return tick_before(pa->dl_abs_deadline, pb->dl_abs_deadline);
+}
+
+// Start a new SCHED_DEADLINE job once its release tick has come: full
+// budget, deadline relative to the release. A job still unfinished at that
+// point has missed its deadline. A process that fell more than a period
+// behind is released now instead of replaying the periods it lost.
+static void dl_replenish(pcb_t* process) {
+    if (tick_before(timer_ticks, process->dl_next_release)) return;
+    if (process->dl_job_active) {
+        process->dl_misses++;
+        dl_misses++;
+    }
+    if (tick_before(process->dl_next_release + process->dl_period, timer_ticks)) {
+        process->dl_next_release = timer_ticks;
+    }
+    process->dl_remaining = process->dl_runtime;
+    process->dl_abs_deadline = process->dl_next_release + process->dl_deadline;
+    process->dl_next_release += process->dl_period;
+    process->dl_job_active = 1;
+}
+
+// SCHED_MLFQ allotment of a level: doubles on each step down
+static uint32_t mlfq_quantum(int level) {
+    return SCHED_MLFQ_BASE_QUANTUM << (SCHED_MLFQ_TOP - level);
+}
+
+// A process whose level predates the last boost is back on the top level.
+// Boosting this lazily keeps blocked processes out of the boost pass.
+static void mlfq_refresh(pcb_t* process) {
+    if (process->mlfq_epoch != mlfq_epoch) {
+        process->mlfq_level = SCHED_MLFQ_TOP;
+        process->mlfq_used = 0;
+        process->mlfq_epoch = mlfq_epoch;
+    }
+}
+
+// Level a process is queued at under the current policy
+static int rq_level_for(pcb_t* process) {
+    if (process->dl_period) return RQ_LEVEL_DEADLINE;
+    if (config.policy == SCHED_FAIR) return RQ_LEVEL_FAIR;
+    if (config.policy == SCHED_MLFQ) {
+        mlfq_refresh(process);
+        return process->mlfq_level;
+    }
+    if (config.policy != SCHED_PRIORITY) return 0;
+    if (process->priority < 0) return 0;
+    if (process->priority >= SCHED_PRIO_LEVELS) return SCHED_PRIO_LEVELS - 1;
+    return process->priority;
+}
+
+static void rq_enqueue(runqueue_t* rq, pcb_t* process, int level) {
+    process->rq_level = level;
+    process->cpu = rq->cpu;
+    trace(TRACE_ENQUEUE, process->pid, -1, (uint32_t)level);
+    if (level == RQ_LEVEL_DEADLINE) {
+        dl_replenish(process);
+        rb_insert(&rq->dl_tree, &process->dl_node, dl_less);
+        rq->nr_running++;
+        return;
+    }
+    if (level == RQ_LEVEL_FAIR) {
+        // A process that slept (or is new) starts at most half a period
+        // behind the pack instead of keeping a huge credit
+        uint64_t floor = rq->min_vruntime;
+        uint64_t credit = (uint64_t)(SCHED_FAIR_LATENCY / 2) << SCHED_FAIR_VRUNTIME_SHIFT;
+        if (floor > credit) floor -= credit;
+        if ((int64_t)(process->vruntime - floor) < 0) process->vruntime = floor;
+        process->weight = fair_weight(process);
+        rq->fair_weight += process->weight;
+        rb_insert(&rq->fair_tree, &process->fair_node, fair_less);
+        rq->nr_running++;
+        return;
+    }
+    process->next = NULL;
+    process->prev = rq->tail[level];
+    if (rq->tail[level]) rq->tail[level]->next = process;
+    else rq->head[level] = process;
+    rq->tail[level] = process;
+    rq->bitmap |= 1u << level;
+    rq->nr_running++;
+}
+
+static void rq_dequeue(runqueue_t* rq, pcb_t* process) {
+    int level = process->rq_level;
+    if (level < 0) return;
+    trace(TRACE_DEQUEUE, process->pid, -1, 0);
+    if (level == RQ_LEVEL_DEADLINE) {
+        rb_erase(&rq->dl_tree, &process->dl_node);
+        process->rq_level = -1;
+        rq->nr_running--;
+        return;
+    }
+    if (level == RQ_LEVEL_FAIR) {
+        rb_erase(&rq->fair_tree, &process->fair_node);
+        rq->fair_weight -= process->weight;
+        process->rq_level = -1;
+        rq->nr_running--;
+        return;
+    }
+    if (process->prev) process->prev->next = process->next;
+    else rq->head[level] = process->next;
+    if (process->next) process->next->prev = process->prev;
+    else rq->tail[level] = process->prev;
+    if (!rq->head[level]) rq->bitmap &= ~(1u << level);
+    process->next = NULL;
+    process->prev = NULL;
+    process->rq_level = -1;
+    rq->nr_running--;
+}
+
+// SCHED_DEADLINE process with the earliest deadline, else the head of the
+// highest non-empty level (BSR on the bitmap), else the SCHED_FAIR process
+// with the smallest vruntime
+static pcb_t* rq_peek(runqueue_t* rq) {
+    rb_node_t* earliest = rb_first(&rq->dl_tree);
+    if (earliest) {
+        return rb_entry(earliest, pcb_t, dl_node);
+    }
+    if (rq->bitmap) {
+        return rq->head[31 - __builtin_clz(rq->bitmap)];
+    }
+    rb_node_t* leftmost = rb_first(&rq->fair_tree);
+    return leftmost ? rb_entry(leftmost, pcb_t, fair_node) : NULL;
+}
+
+// Global SCHED_MLFQ boost. Bumping the epoch moves everyone not queued
+// (running or blocked) to the top when it is next looked at; only the
+// queued processes below the top are moved now, highest level first so
+// their relative order survives.
+static void mlfq_boost(void) {
+    mlfq_epoch++;
+    mlfq_boosts++;
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        runqueue_t* rq = &smp_cpu(i)->rq;
+        for (int level = SCHED_MLFQ_TOP - 1; level >= 0; level--) {
+            pcb_t* process;
+            while ((process = rq->head[level])) {
+                rq_dequeue(rq, process);
+                mlfq_refresh(process);
+                rq_enqueue(rq, process, SCHED_MLFQ_TOP);
+            }
+        }
+    }
+}
+
+// Busiest other CPU worth stealing from: one with work queued behind a
+// running process, or more than one process queued
+static cpu_t* steal_victim(cpu_t* self) {
+    cpu_t* victim = NULL;
+    uint32_t max_load = 1;
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        cpu_t* cpu = smp_cpu(i);
+        if (cpu == self || !cpu->online || !cpu->rq.nr_running) continue;
+        uint32_t load = cpu->rq.nr_running + (cpu->current_pid != cpu->idle->pid);
+        if (load > max_load) {
+            max_load = load;
+            victim = cpu;
+        }
+    }
+    return victim;
+}
+
+// Move the process the busiest CPU would run next onto this CPU's queue
+static pcb_t* rq_steal(cpu_t* self) {
+    cpu_t* victim = steal_victim(self);
+    if (!victim) return NULL;
+    
+    pcb_t* process = rq_peek(&victim->rq);
+    int level = process->rq_level;
+    rq_dequeue(&victim->rq, process);
+    if (level == RQ_LEVEL_FAIR) {
+        // vruntime only means something relative to its queue's floor
+        process->vruntime += self->rq.min_vruntime - victim->rq.min_vruntime;
+    }
+    rq_enqueue(&self->rq, process, level);
+    self->steals++;
+    return process;
+}
+
+// Charge one tick to a running SCHED_FAIR process and advance the floor
+static void fair_account(runqueue_t* rq, pcb_t* current) {
+    current->vruntime += (SCHED_FAIR_NICE0_WEIGHT << SCHED_FAIR_VRUNTIME_SHIFT) /
+                         fair_weight(current);
+    
+    uint64_t floor = current->vruntime;
+    rb_node_t* leftmost = rb_first(&rq->fair_tree);
+    if (leftmost) {
+        pcb_t* first = rb_entry(leftmost, pcb_t, fair_node);
+        if ((int64_t)(first->vruntime - floor) < 0) floor = first->vruntime;
+    }
+    if ((int64_t)(floor - rq->min_vruntime) > 0) rq->min_vruntime = floor;
+}
+
+// Main scheduling function
+void schedule(void) {
+    uint32_t irq = irq_save();
+    pcb_t* current = get_current_process();
+    pcb_t* next = pick_next_process();
+    
+    if (!next) {
+        // Nothing queued here or worth stealing, run idle
+        next = this_cpu()->idle;
+    }
+    
+    if (current != next) {
+        context_switch(next);
+    }
+    irq_restore(irq);
+}
+
+// Switch the CPU to `next`. Returns when the outgoing process is picked
+// again (never, if it has terminated).
+void context_switch(pcb_t* next) {
+    pcb_t* current = get_current_process();
+    cpu_t* cpu = this_cpu();
+    
+    if (current == next) return;
+    
+    // Interrupts stay off until the incoming process restores its own
+    // flags (or, for a new process, until process_start enables them)
+    uint32_t irq = irq_save();
+    
+    LOG(SCHED, LOG_DEBUG, LOGMSG_CONTEXT_SWITCH, current ? current->pid : -1, next->pid);
+    
+    // Save current process state. The idle process is never queued; it
+    // runs only when the ready queue is empty.
+    if (current && current->state == CURRENT) {
+        set_pcb_state(current, READY);
+        if (current != cpu->idle) add_to_ready_queue(current);
+    }
+    
+    // Update next process (this also makes it the current PID)
+    if (next->rq_level >= 0) rq_dequeue(rq_of(next), next);
+    set_process_state(next->pid, CURRENT);
+    next->cpu = cpu->id;
+    
+    // Kernel lock depth the outgoing process resumes at
+    if (current) current->lock_depth = cpu->lock_depth;
+    cpu->current_tick = 0;
+    
+    context_switches++;
+    
+    // Another CPU may have unmapped stack pages this one still has cached
+    if (smp_active && cpu->tlb_generation != paging_tlb_generation()) {
+        cpu->tlb_generation = paging_tlb_generation();
+        paging_flush_tlb();
+    }
+    
+    // A process that has just terminated itself has no PCB any more; its
+    // registers are saved into a scratch word and never loaded again
+    static uint32_t dead_sp;
+    uint32_t* save_sp = current ? &current->stack_pointer : &dead_sp;
+    int current_pid = current ? current->pid : -1;
+    trace(TRACE_SWITCH_OUT, current_pid, next->pid, current ? current->state : TERMINATED);
+    trace(TRACE_SWITCH_IN, next->pid, current_pid, 0);
+    cpu->switch_start_tsc = rdtsc();
+    switch_stacks(save_sp, next->stack_pointer);
+    context_switch_finish();
+    irq_restore(irq);
+}
+
+// Runs first on the incoming stack, both here and in process_start for a
+// process that has never run: records the switch cost, frees the stack of
+// a process that exited on the way out and takes over the kernel lock
+void context_switch_finish(void) {
+    cpu_t* cpu = this_cpu();
+    uint32_t cycles = (uint32_t)(rdtsc() - cpu->switch_start_tsc);
+    switch_cycles_total += cycles;
+    switch_samples++;
+    if (cycles < switch_cycles_min) switch_cycles_min = cycles;
+    if (cycles > switch_cycles_max) switch_cycles_max = cycles;
+    
+    process_reap();
+    kernel_lock_handoff(get_current_process()->lock_depth);
+}
+
+// Add process to ready queue
+void add_to_ready_queue(pcb_t* process) {
+    if (!process || process->state == TERMINATED) return;
+    
+    uint32_t irq = irq_save();
+    if (process->rq_level >= 0) rq_dequeue(rq_of(process), process);  // Never queued twice
+    rq_enqueue(local_rq(), process, rq_level_for(process));
+    set_pcb_state(process, READY);
+    irq_restore(irq);
+}
+
+// Remove process from ready queue
+void remove_from_ready_queue(int pid) {
+    pcb_t* process = get_process(pid);
+    if (!process) return;
+    uint32_t irq = irq_save();
+    if (process->rq_level >= 0) rq_dequeue(rq_of(process), process);
+    irq_restore(irq);
+}
+
+static void sleep_list_insert(pcb_t* process) {
+    pcb_t* prev = NULL;
+    pcb_t* current = sleep_list;
+    while (current && !tick_before(process->wake_tick, current->wake_tick)) {
+        prev = current;
+        current = current->timer_next;
+    }
+    process->timer_prev = prev;
+    process->timer_next = current;
+    if (current) current->timer_prev = process;
+    if (prev) prev->timer_next = process;
+    else sleep_list = process;
+}
+
+static void sleep_list_remove(pcb_t* process) {
+    if (process->timer_prev) process->timer_prev->timer_next = process->timer_next;
+    else if (sleep_list == process) sleep_list = process->timer_next;
+    else return;  // Not on the list
+    if (process->timer_next) process->timer_next->timer_prev = process->timer_prev;
+    process->timer_next = NULL;
+    process->timer_prev = NULL;
+}
+
+// Park the running process as BLOCKED and run something else. It becomes
+// READY again through wake_process or, if `timeout_ticks` is not
+// IPC_WAIT_FOREVER, when that many ticks pass.
+void block_current_process(wait_reason_t reason, uint32_t timeout_ticks) {
+    pcb_t* current = get_current_process();
+    if (!current || current == this_cpu()->idle) return;
+    
+    uint32_t irq = irq_save();
+    if (current->rq_level >= 0) rq_dequeue(rq_of(current), current);
+    set_pcb_state(current, BLOCKED);
+    current->wait_reason = reason;
+    trace(TRACE_BLOCK, current->pid, -1, reason);
+    if (timeout_ticks != IPC_WAIT_FOREVER) {
+        current->wake_tick = timer_ticks + timeout_ticks;
+        sleep_list_insert(current);
+    }
+    schedule();
+    irq_restore(irq);
+}
+
+// Park the running process as BLOCKED and switch straight to `next`,
+// bypassing pick_next_process. `next` may be BLOCKED itself (a rendezvous
+// partner) or READY.
+void block_and_handoff(wait_reason_t reason, pcb_t* next) {
+    pcb_t* current = get_current_process();
+    if (!current || current == this_cpu()->idle || !next) return;
+    
+    uint32_t irq = irq_save();
+    if (current->rq_level >= 0) rq_dequeue(rq_of(current), current);
+    set_pcb_state(current, BLOCKED);
+    current->wait_reason = reason;
+    trace(TRACE_BLOCK, current->pid, -1, reason);
+    if (next->state == BLOCKED) trace(TRACE_WAKE, next->pid, current->pid, 0);
+    
+    sleep_list_remove(next);
+    next->wait_reason = WAIT_NONE;
+    handoffs++;
+    context_switch(next);
+    irq_restore(irq);
+}
+
+// Make a BLOCKED process runnable again; the waker keeps the CPU
+void wake_process(pcb_t* process) {
+    if (!process || process->state != BLOCKED) return;
+    uint32_t irq = irq_save();
+    trace(TRACE_WAKE, process->pid, get_current_pid(), 0);
+    sleep_list_remove(process);
+    process->wait_reason = WAIT_NONE;
+    add_to_ready_queue(process);
+    irq_restore(irq);
+}
+
+// Drop every scheduler reference to a process that is going away
+void scheduler_remove(pcb_t* process) {
+    if (!process) return;
+    uint32_t irq = irq_save();
+    trace(TRACE_TERMINATE, process->pid, -1, 0);
+    if (process->rq_level >= 0) rq_dequeue(rq_of(process), process);
+    sleep_list_remove(process);
+    if (process->dl_period) {
+        dl_total_util -= (uint32_t)div64_32((uint64_t)process->dl_runtime << SCHED_DL_UTIL_SHIFT,
+                                            process->dl_period);
+        process->dl_period = 0;
+    }
+    irq_restore(irq);
+}
+
+uint32_t get_ticks(void) {
+    return timer_ticks;
+}
+
+// Pick next process based on scheduling policy. Every policy is a run-queue
+// peek; SCHED_PRIORITY and SCHED_MLFQ just file processes by level.
+// Starvation is handled by the periodic SCHED_MLFQ boost in timer_tick, not
+// here, so picking stays O(1). A CPU with nothing queued steals.
+pcb_t* pick_next_process(void) {
+    cpu_t* cpu = this_cpu();
+    pcb_t* next = rq_peek(&cpu->rq);
+    return next ? next : rq_steal(cpu);
+}
+
+// Timer interrupt handler: IRQ0 on the BSP (pit.c), the LAPIC timer on
+// every other CPU (lapic.c). Global time and timed waits advance on the
+// BSP only; the rest is about the calling CPU.
+void timer_tick(void) {
+    uint32_t irq = irq_save();
+    cpu_t* cpu = this_cpu();
+    runqueue_t* rq = &cpu->rq;
+    cpu->ticks++;
+    cpu->current_tick++;
+    
+    if (cpu->id == 0) {
+        timer_ticks++;
+        
+        // Expire timed waits; the woken receiver finds its mailbox still empty
+        while (sleep_list && !tick_before(timer_ticks, sleep_list->wake_tick)) {
+            wake_process(sleep_list);
+        }
+        
+        if (config.policy == SCHED_MLFQ && config.aging_enabled &&
+            timer_ticks % SCHED_MLFQ_BOOST_INTERVAL == 0) {
+            mlfq_boost();
+        }
+    }
+    
+    pcb_t* current = get_current_process();
+    if (current && current->kill_pending) {
+        terminate_process(current->pid);  // Does not return
+    }
+    if (current != cpu->idle) cpu->busy_ticks++;
+    rb_node_t* first_dl = rb_first(&rq->dl_tree);
+    pcb_t* earliest = first_dl ? rb_entry(first_dl, pcb_t, dl_node) : NULL;
+    if (current == cpu->idle) {
+        // Idle gives way as soon as anything is runnable here or elsewhere
+        if (rq->nr_running || steal_victim(cpu)) schedule();
+    } else if (current && current->dl_period) {
+        if (current->dl_remaining) current->dl_remaining--;
+        if (!current->dl_remaining) {
+            // Budget used up by this tick: sit out until the next release,
+            // or start the next job right away if that release has passed
+            if (tick_before(timer_ticks, current->dl_next_release)) {
+                dl_throttles++;
+                block_current_process(WAIT_THROTTLED, current->dl_next_release - timer_ticks);
+                irq_restore(irq);
+                return;
+            }
+            dl_replenish(current);
+        }
+        if (earliest && tick_before(earliest->dl_abs_deadline, current->dl_abs_deadline)) {
+            schedule();
+        }
+    } else if (current && earliest) {
+        schedule();  // Real-time work preempts best-effort processes
+    } else if (current && config.policy == SCHED_FAIR) {
+        fair_account(rq, current);
+        if (cpu->current_tick >= fair_slice(rq, current)) {
+            schedule();
+        }
+    } else if (current && config.policy == SCHED_MLFQ) {
+        mlfq_refresh(current);
+        if (++current->mlfq_used >= mlfq_quantum(current->mlfq_level)) {
+            // Used its whole allotment: demote and go behind the new level
+            if (current->mlfq_level > 0) {
+                current->mlfq_level--;
+                mlfq_demotions++;
+            }
+            current->mlfq_used = 0;
+            schedule();
+        } else if (rq->bitmap >> (current->mlfq_level + 1)) {
+            schedule();  // Something on a higher level became runnable
+        }
+    } else if (current) {
+        // Check if time quantum expired
+        if (config.policy == SCHED_ROUND_ROBIN && 
+            cpu->current_tick >= config.time_quantum) {
+            LOG(SCHED, LOG_DEBUG, LOGMSG_QUANTUM_EXPIRED, current->pid);
+            schedule();
+        }
+    }
+    irq_restore(irq);
+}
+
+// Change scheduling policy
+void set_scheduling_policy(sched_policy_t policy) {
+    uint32_t irq = irq_save();
+    config.policy = policy;
+    
+    // Re-file everything queued under the old policy's levels, highest
+    // level first, then the fair tree in vruntime order, on every CPU
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        runqueue_t* rq = &smp_cpu(i)->rq;
+        pcb_t* chain = NULL;
+        pcb_t** tail = &chain;
+        pcb_t* current;
+        while ((current = rq_peek(rq))) {
+            rq_dequeue(rq, current);
+            current->next = NULL;
+            *tail = current;
+            tail = &current->next;
+        }
+        while (chain) {
+            current = chain;
+            chain = chain->next;
+            rq_enqueue(rq, current, rq_level_for(current));
+        }
+    }
+    irq_restore(irq);
+    printf_serial("Scheduling policy changed\n");
+}
+
+// Change time quantum
+void set_time_quantum(uint32_t quantum) {
+    config.time_quantum = quantum;
+    printf_serial("Time quantum set to %u\n", quantum);
+}
+
+// Enable/disable the periodic SCHED_MLFQ boost
+void enable_aging(int enable) {
+    config.aging_enabled = enable;
+    printf_serial("MLFQ boost %s\n", enable ? "enabled" : "disabled");
+}
+
+// Give process `pid` a SCHED_DEADLINE reservation of `runtime` ticks every
+// `period` ticks, each job due `deadline` ticks after its release. Refused
+// (-1) if the total utilization would exceed SCHED_DL_MAX_UTIL. A runtime
+// of 0 returns the process to the best-effort policy.
+int sched_set_deadline(int pid, uint32_t runtime, uint32_t deadline, uint32_t period) {
+    pcb_t* process = get_process(pid);
+    if (!process || scheduler_is_idle(process)) return -1;
+    if (runtime && (runtime > deadline || deadline > period)) {
+        printf_serial("Error: SCHED_DEADLINE needs runtime <= deadline <= period\n");
+        return -1;
+    }
+    
+    uint32_t irq = irq_save();
+    uint32_t old_util = process->dl_period ?
+        (uint32_t)div64_32((uint64_t)process->dl_runtime << SCHED_DL_UTIL_SHIFT, process->dl_period) : 0;
+    uint32_t util = runtime ?
+        (uint32_t)div64_32((uint64_t)runtime << SCHED_DL_UTIL_SHIFT, period) : 0;
+    if (dl_total_util - old_util + util > SCHED_DL_MAX_UTIL) {
+        irq_restore(irq);
+        printf_serial("SCHED_DEADLINE admission refused for PID %d\n", pid);
+        return -1;
+    }
+    dl_total_util = dl_total_util - old_util + util;
+    
+    int queued = process->rq_level >= 0;
+    runqueue_t* rq = rq_of(process);
+    if (queued) rq_dequeue(rq, process);
+    process->dl_runtime = runtime;
+    process->dl_deadline = runtime ? deadline : 0;
+    process->dl_period = runtime ? period : 0;
+    if (runtime) {
+        // First job is released now
+        process->dl_next_release = timer_ticks;
+        process->dl_job_active = 0;
+        dl_replenish(process);
+    }
+    if (queued) rq_enqueue(rq, process, rq_level_for(process));
+    irq_restore(irq);
+    return 0;
+}
+
+// End the running SCHED_DEADLINE process's current job and sleep until the
+// next one is released. Finishing after the deadline counts as a miss.
+void sched_wait_next_period(void) {
+    pcb_t* current = get_current_process();
+    if (!current || !current->dl_period) return;
+    
+    uint32_t irq = irq_save();
+    if (current->dl_job_active && tick_before(current->dl_abs_deadline, timer_ticks)) {
+        current->dl_misses++;
+        dl_misses++;
+    }
+    current->dl_job_active = 0;
+    if (tick_before(timer_ticks, current->dl_next_release)) {
+        block_current_process(WAIT_PERIOD, current->dl_next_release - timer_ticks);
+    } else {
+        dl_replenish(current);
+    }
+    irq_restore(irq);
+}
+
+// Print x/total as a percentage with one decimal
+static void print_percent(uint64_t x, uint64_t total) {
+    uint32_t tenths = permille(x, total);
+    printf_serial("%u.%u%%", tenths / 10, tenths % 10);
+}
+
+// Reservation, utilization and misses of every SCHED_DEADLINE process
+static void dl_stats(void) {
+    printf_serial("Deadline: %u misses, %u throttles, utilization ", dl_misses, dl_throttles);
+    print_percent(dl_total_util, SCHED_DL_UTIL_ONE);
+    printf_serial("\n");
+    printf_serial("PID\tRuntime\tDeadline\tPeriod\tMisses\n");
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || !proc->dl_period) continue;
+        printf_serial("%d\t%u\t%u\t\t%u\t%u\n", proc->pid, proc->dl_runtime,
+                      proc->dl_deadline, proc->dl_period, proc->dl_misses);
+    }
+}
+
+// CPU share each process actually got against the share its weight entitles
+// it to, over its lifetime so far
+static void fair_stats(void) {
+    uint64_t total_time = 0;
+    uint32_t total_weight = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || scheduler_is_idle(proc)) continue;
+        total_time += process_cycles(proc, CURRENT);
+        total_weight += fair_weight(proc);
+    }
+    
+    printf_serial("PID\tWeight\tvruntime\tShare\tTarget\n");
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || scheduler_is_idle(proc)) continue;
+        printf_serial("%d\t%u\t%u\t\t", proc->pid, fair_weight(proc),
+                      (uint32_t)(proc->vruntime >> SCHED_FAIR_VRUNTIME_SHIFT));
+        print_percent(process_cycles(proc, CURRENT), total_time);
+        printf_serial("\t");
+        print_percent(fair_weight(proc), total_weight);
+        printf_serial("\n");
+    }
+}
+
+// Level and allotment use of every SCHED_MLFQ process
+static void mlfq_stats(void) {
+    printf_serial("MLFQ: %u demotions, %u boosts\n", mlfq_demotions, mlfq_boosts);
+    printf_serial("PID\tLevel\tUsed\tQuantum\n");
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || scheduler_is_idle(proc)) continue;
+        int level = proc->mlfq_epoch == mlfq_epoch ? proc->mlfq_level : SCHED_MLFQ_TOP;
+        uint32_t used = proc->mlfq_epoch == mlfq_epoch ? proc->mlfq_used : 0;
+        printf_serial("%d\t%d\t%u\t%u\n", proc->pid, level, used, mlfq_quantum(level));
+    }
+}
+
+// Display scheduler statistics
+void scheduler_stats(void) {
+    printf_serial("=== Scheduler Statistics ===\n");
+    printf_serial("Total timer ticks: %u\n", timer_ticks);
+    printf_serial("Context switches: %u (%u direct handoffs)\n", context_switches, handoffs);
+    if (switch_samples) {
+        printf_serial("Switch cost: %u cycles avg (min %u, max %u)\n",
+                      (uint32_t)div64_32(switch_cycles_total, switch_samples),
+                      switch_cycles_min, switch_cycles_max);
+    }
+    uint32_t queued = 0;
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        queued += smp_cpu(i)->rq.nr_running;
+    }
+    printf_serial("Processes in ready queues: %u\n", queued);
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        cpu_t* cpu = smp_cpu(i);
+        if (!cpu->online) continue;
+        printf_serial("  CPU %d: PID %d running, %u queued", i, cpu->current_pid, cpu->rq.nr_running);
+        if ((config.policy == SCHED_PRIORITY || config.policy == SCHED_MLFQ) &&
+            cpu->rq.bitmap) {
+            printf_serial(" (levels 0x%x)", cpu->rq.bitmap);
+        }
+        printf_serial(", busy %u/%u ticks", cpu->busy_ticks, cpu->ticks);
+        if (cpu->idle) {
+            // The idle process is READY exactly while the CPU runs anything else
+            uint64_t busy = process_cycles(cpu->idle, READY);
+            printf_serial(" (");
+            print_percent(busy, busy + process_cycles(cpu->idle, CURRENT));
+            printf_serial(" by TSC)");
+        }
+        printf_serial(", %u steals\n", cpu->steals);
+    }
+    
+    if (dl_total_util || dl_misses) {
+        dl_stats();
+    }
+    if (config.policy == SCHED_FAIR) {
+        fair_stats();
+    } else if (config.policy == SCHED_MLFQ) {
+        mlfq_stats();
+    }
+    printf_serial("Current time quantum: %u\n", config.time_quantum);
+    printf_serial("MLFQ boost: %s\n", config.aging_enabled ? "ON" : "OFF");
+}
+
+// Time each process has spent running, queued and blocked, and the
+// distribution of its READY-to-CURRENT waits
+void sched_latency_stats(void) {
+    printf_serial("=== Scheduling Latency (TSC %u kHz) ===\n", tsc_khz());
+    printf_serial("PID\tRun (us)\tReady (us)\tBlocked (us)\tUtil\tMax lat (us)\n");
+    uint32_t worst = 0;
+    int worst_pid = -1;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || scheduler_is_idle(proc)) continue;
+        uint64_t run = process_cycles(proc, CURRENT);
+        uint64_t ready = process_cycles(proc, READY);
+        uint64_t blocked = process_cycles(proc, BLOCKED);
+        printf_serial("%d\t%u\t\t%u\t\t%u\t\t", proc->pid, tsc_to_us(run),
+                      tsc_to_us(ready), tsc_to_us(blocked));
+        print_percent(run, run + ready + blocked);
+        printf_serial("\t%u\n", proc->latency_max);
+        if (proc->latency_max >= worst) {
+            worst = proc->latency_max;
+            worst_pid = proc->pid;
+        }
+    }
+    printf_serial("Max scheduling latency: %u us (PID %d)\n", worst, worst_pid);
+    
+    // One row per process, one column per log2 bucket up to its longest wait
+    printf_serial("Latency histogram, waits per bucket (us):\n");
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc || scheduler_is_idle(proc)) continue;
+        int top = LATENCY_BUCKETS - 1;
+        while (top > 0 && !proc->latency_hist[top]) top--;
+        printf_serial("  PID %d:", proc->pid);
+        for (int b = 0; b <= top; b++) {
+            if (b == LATENCY_BUCKETS - 1) {
+                printf_serial(" >=%u:%u", 1u << b, proc->latency_hist[b]);
+            } else {
+                printf_serial(" <%u:%u", 2u << b, proc->latency_hist[b]);
+            }
+        }
+        printf_serial("\n");
+    }
+}
@@ -1,35 +1,96 @@
-// scheduler.h
-#ifndef SCHEDULER_H
-#define SCHEDULER_H
-
-#include "process.h"
-
-// Scheduling policies
-typedef enum {
-    SCHED_ROUND_ROBIN,
-    SCHED_PRIORITY,
-    SCHED_FCFS
-} sched_policy_t;
-
-// Scheduler configuration
-typedef struct {
-    sched_policy_t policy;
-    uint32_t time_quantum;
-    int aging_enabled;      // Bonus feature
-    uint32_t max_priority;
-} sched_config_t;
-
-// Scheduler API
-void scheduler_init(sched_policy_t policy, uint32_t quantum);
-void schedule(void);
-void context_switch(pcb_t* next);
-void add_to_ready_queue(pcb_t* process);
-void remove_from_ready_queue(int pid);
-void set_scheduling_policy(sched_policy_t policy);
-void set_time_quantum(uint32_t quantum);
-void enable_aging(int enable);
-pcb_t* pick_next_process(void);
-void timer_tick(void);
-void scheduler_stats(void);
-
+// scheduler.h
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "process.h"
+
+// Scheduling policies
+typedef enum {
+    SCHED_ROUND_ROBIN,
+    SCHED_PRIORITY,
+    SCHED_FCFS,
+    SCHED_FAIR,             // Weighted virtual runtime, leftmost first
+    SCHED_MLFQ              // Multi-level feedback queue
+} sched_policy_t;
+
+// SCHED_FAIR tuning, in timer ticks. Every runnable process should run once
+// per latency period; with many of them the period stretches so no slice
+// drops below the minimum granularity.
+#define SCHED_FAIR_LATENCY         10
+#define SCHED_FAIR_MIN_GRANULARITY 1
+#define SCHED_FAIR_NICE0_WEIGHT    1024   // Weight of priority 1
+#define SCHED_FAIR_VRUNTIME_SHIFT  10     // vruntime is in 1/1024 ticks
+
+// SCHED_MLFQ tuning. New and boosted processes start on the top level with
+// the shortest quantum; using up a level's allotment demotes a process one
+// level, where the quantum doubles. Every boost interval all processes go
+// back to the top, so nothing starves.
+#define SCHED_MLFQ_LEVELS         8
+#define SCHED_MLFQ_TOP            (SCHED_MLFQ_LEVELS - 1)
+#define SCHED_MLFQ_BASE_QUANTUM   2       // Ticks on the top level
+#define SCHED_MLFQ_BOOST_INTERVAL 100     // Ticks between global boosts
+
+// SCHED_DEADLINE is a class rather than a policy: a process given a
+// runtime/deadline/period with sched_set_deadline runs ahead of every
+// best-effort process, earliest absolute deadline first. Admission keeps
+// the summed runtime/period below SCHED_DL_MAX_UTIL so the best-effort
+// policy still gets the rest.
+#define SCHED_DL_UTIL_SHIFT 20
+#define SCHED_DL_UTIL_ONE   (1u << SCHED_DL_UTIL_SHIFT)
+#define SCHED_DL_MAX_UTIL   (SCHED_DL_UTIL_ONE / 100 * 90)
+
+// Run queue: one FIFO per priority level plus a bitmap of the non-empty
+// levels, so enqueue, dequeue and pick are O(1) whatever the load.
+// Higher levels run first; round-robin and FCFS use level 0 only.
+// Every CPU has one (smp.h); an idle CPU steals from the busiest.
+#define SCHED_PRIO_LEVELS 32
+#define RQ_LEVEL_FAIR     SCHED_PRIO_LEVELS  // rq_level of a SCHED_FAIR process
+#define RQ_LEVEL_DEADLINE (SCHED_PRIO_LEVELS + 1)  // ... and of a SCHED_DEADLINE one
+
+typedef struct {
+    pcb_t* head[SCHED_PRIO_LEVELS];
+    pcb_t* tail[SCHED_PRIO_LEVELS];
+    uint32_t bitmap;            // Bit n set while level n is non-empty
+    uint32_t nr_running;
+    int cpu;                    // Owning CPU
+    rb_tree_t fair_tree;        // SCHED_FAIR processes keyed on vruntime
+    uint32_t fair_weight;       // Sum of weights in fair_tree
+    uint64_t min_vruntime;      // Monotonic floor for newly queued processes
+    rb_tree_t dl_tree;          // SCHED_DEADLINE processes keyed on dl_abs_deadline
+} runqueue_t;
+
+// Scheduler configuration
+typedef struct {
+    sched_policy_t policy;
+    uint32_t time_quantum;
+    int aging_enabled;      // Periodic SCHED_MLFQ boost
+} sched_config_t;
+
+// Register-level stack switch (switch.S)
+void switch_stacks(uint32_t* save_sp, uint32_t load_sp);
+
+// Scheduler API
+void scheduler_init(sched_policy_t policy, uint32_t quantum);
+void scheduler_init_cpu(void);
+int scheduler_is_idle(pcb_t* process);
+void schedule(void);
+void context_switch(pcb_t* next);
+void context_switch_finish(void);
+void add_to_ready_queue(pcb_t* process);
+void remove_from_ready_queue(int pid);
+void block_current_process(wait_reason_t reason, uint32_t timeout_ticks);
+void block_and_handoff(wait_reason_t reason, pcb_t* next);
+void wake_process(pcb_t* process);
+void scheduler_remove(pcb_t* process);
+uint32_t get_ticks(void);
+void set_scheduling_policy(sched_policy_t policy);
+void set_time_quantum(uint32_t quantum);
+void enable_aging(int enable);
+int sched_set_deadline(int pid, uint32_t runtime, uint32_t deadline, uint32_t period);
+void sched_wait_next_period(void);
+pcb_t* pick_next_process(void);
+void timer_tick(void);
+void scheduler_stats(void);
+void sched_latency_stats(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,287 @@
+/* smp.c - Multiprocessor bring-up and the big kernel lock */
+#include "smp.h"
+#include "lapic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "page.h"
+#include "paging.h"
+#include "pit.h"
+#include "sync.h"
+#include "io.h"
+
+// Operand layout of ap_boot.S, starting at ap_params
+typedef struct {
+    uint16_t gdt_limit;
+    uint32_t gdt_base;
+    uint16_t pad;
+    uint32_t cr3;
+    uint32_t cr4;
+    uint32_t stack;
+    uint32_t entry;
+} __attribute__((packed)) ap_params_t;
+
+extern uint8_t ap_trampoline[], ap_trampoline_end[], ap_params[];  // ap_boot.S
+
+static cpu_t cpus[MAX_CPUS];
+static int cpu_count = 1;
+static uintptr_t lapic_base = LAPIC_DEFAULT_BASE;
+
+volatile int smp_active = 0;          // Set once a second CPU may run
+static spinlock_t big_lock;
+
+cpu_t* smp_cpu(int id) {
+    return &cpus[id];
+}
+
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+// Big kernel lock, taken by irq_save once smp_active is set. A ticket
+// spinlock made recursive per CPU; interrupts are already off when it is
+// taken, so the holder is never preempted while others spin.
+void kernel_lock(void) {
+    cpu_t* cpu = this_cpu();
+    if (cpu->lock_depth++ == 0) {
+        spin_lock(&big_lock);
+    }
+}
+
+void kernel_unlock(void) {
+    cpu_t* cpu = this_cpu();
+    if (--cpu->lock_depth == 0) {
+        spin_unlock(&big_lock);
+    }
+}
+
+// The lock is held across a context switch, by the CPU rather than by the
+// process. The incoming process resumes at the nesting depth it switched
+// out at; a process running for the first time starts outside any critical
+// section, so the lock is dropped for it here.
+void kernel_lock_handoff(uint32_t depth) {
+    if (!smp_active) return;
+    this_cpu()->lock_depth = depth;
+    if (depth == 0) {
+        spin_unlock(&big_lock);
+    }
+}
+
+static int checksum_ok(const uint8_t* p, uint32_t len) {
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) sum += p[i];
+    return sum == 0;
+}
+
+// Find a 16-byte aligned structure starting with `sig` in [start, end)
+static const uint8_t* scan(uintptr_t start, uintptr_t end, const char* sig, uint32_t len) {
+    for (uintptr_t p = start; p + len <= end; p += 16) {
+        const uint8_t* s = (const uint8_t*)p;
+        uint32_t i = 0;
+        while (sig[i] && s[i] == (uint8_t)sig[i]) i++;
+        if (!sig[i] && checksum_ok(s, len)) return s;
+    }
+    return NULL;
+}
+
+// The BIOS areas both tables may live in: first KB of the EBDA, last KB of
+// base memory, and the BIOS ROM
+static const uint8_t* scan_bios(const char* sig, uint32_t len) {
+    uint32_t segment;
+    __asm__ volatile ("movzwl 0x40E, %0" : "=r"(segment));  // EBDA segment, BIOS data area
+    uintptr_t ebda = (uintptr_t)segment << 4;
+    const uint8_t* found = NULL;
+    if (ebda) found = scan(ebda, ebda + 1024, sig, len);
+    if (!found) found = scan(0x9FC00, 0xA0000, sig, len);
+    if (!found) found = scan(0xE0000, 0x100000, sig, len);
+    return found;
+}
+
+static void add_cpu(uint8_t apic_id) {
+    if (cpu_count >= MAX_CPUS) return;
+    cpus[cpu_count++].apic_id = apic_id;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+    return *(const uint32_t*)p;
+}
+
+// ACPI: RSDP -> RSDT -> MADT, one processor-local-APIC entry per CPU
+static int discover_madt(void) {
+    const uint8_t* rsdp = scan_bios("RSD PTR ", 20);
+    if (!rsdp) return 0;
+    
+    uintptr_t rsdt = read32(rsdp + 16);
+    if (!paging_identity_map(rsdt, 36, PTE_WRITE)) return 0;
+    uint32_t rsdt_len = read32((const uint8_t*)rsdt + 4);
+    if (!paging_identity_map(rsdt, rsdt_len, PTE_WRITE)) return 0;
+    
+    for (uint32_t off = 36; off + 4 <= rsdt_len; off += 4) {
+        uintptr_t table = read32((const uint8_t*)rsdt + off);
+        if (!paging_identity_map(table, 36, PTE_WRITE)) continue;
+        const uint8_t* madt = (const uint8_t*)table;
+        if (madt[0] != 'A' || madt[1] != 'P' || madt[2] != 'I' || madt[3] != 'C') continue;
+        
+        uint32_t len = read32(madt + 4);
+        if (!paging_identity_map(table, len, PTE_WRITE) || !checksum_ok(madt, len)) return 0;
+        lapic_base = read32(madt + 36);
+        for (uint32_t e = 44; e + 2 <= len && madt[e + 1]; e += madt[e + 1]) {
+            // Type 0: processor local APIC, flags bit 0 = enabled
+            if (madt[e] == 0 && (read32(madt + e + 4) & 1)) {
+                add_cpu(madt[e + 3]);
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Intel MultiProcessor table, for firmware without ACPI
+static int discover_mp(void) {
+    const uint8_t* mpf = scan_bios("_MP_", 16);
+    if (!mpf || !read32(mpf + 4)) return 0;
+    
+    uintptr_t table = read32(mpf + 4);
+    if (!paging_identity_map(table, 44, PTE_WRITE)) return 0;
+    const uint8_t* conf = (const uint8_t*)table;
+    if (conf[0] != 'P' || conf[1] != 'C' || conf[2] != 'M' || conf[3] != 'P') return 0;
+    uint16_t len = *(const uint16_t*)(conf + 4);
+    uint16_t entries = *(const uint16_t*)(conf + 34);
+    if (!paging_identity_map(table, len, PTE_WRITE) || !checksum_ok(conf, len)) return 0;
+    lapic_base = read32(conf + 36);
+    
+    const uint8_t* e = conf + 44;
+    for (uint16_t i = 0; i < entries && e < conf + len; i++) {
+        if (e[0] == 0) {                // Processor: 20 bytes
+            if (e[3] & 1) add_cpu(e[1]);
+            e += 20;
+        } else {                        // Bus, I/O APIC, interrupts: 8 bytes
+            e += 8;
+        }
+    }
+    return 1;
+}
+
+// First code in C on an application processor, on its own stack with
+// paging on and GS already naming its cpu_t
+static void ap_main(void) {
+    cpu_t* cpu = this_cpu();
+    gdt_load_cpu(cpu->id);
+    idt_load();
+    lapic_enable();
+    scheduler_init_cpu();
+    lapic_timer_start();
+    cpu->online = 1;
+    
+    // Idle loop, as kmain's on the BSP
+    __asm__ volatile ("sti");
+    for (;;) {
+        __asm__ volatile ("hlt");
+        schedule();
+    }
+}
+
+// Wait `ticks` PIT ticks (at least one, however short the request)
+static void delay_ticks(uint32_t ticks) {
+    uint32_t start = get_ticks();
+    while (get_ticks() - start < ticks) __asm__ volatile ("hlt");
+}
+
+// INIT, then two STARTUP IPIs pointing at the trampoline, then wait for
+// the AP to report in
+static int boot_ap(cpu_t* cpu) {
+    void* stack = page_alloc(AP_STACK_ORDER, PAGE_USED);
+    if (!stack) return 0;
+    
+    gdt_setup_cpu(cpu->id);
+    
+    ap_params_t* params = (ap_params_t*)(AP_TRAMPOLINE + (ap_params - ap_trampoline));
+    memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    uint16_t gdt_limit;
+    uint32_t gdt_base;
+    gdt_get_pointer(cpu->id, &gdt_limit, &gdt_base);
+    params->gdt_limit = gdt_limit;
+    params->gdt_base = gdt_base;
+    uint32_t cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    params->cr3 = (uint32_t)(uintptr_t)paging_kernel_directory();
+    params->cr4 = cr4;
+    params->stack = (uint32_t)(uintptr_t)stack + (PAGE_SIZE << AP_STACK_ORDER);
+    params->entry = (uint32_t)(uintptr_t)ap_main;
+    
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    delay_ticks(1);
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    delay_ticks(1);
+    for (int i = 0; i < 2 && !cpu->online; i++) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+        delay_ticks(1);
+    }
+    
+    for (uint32_t waited = 0; !cpu->online && waited < TIMER_HZ; waited++) {
+        delay_ticks(1);
+    }
+    if (!cpu->online) {
+        page_free(stack);
+        return 0;
+    }
+    return 1;
+}
+
+// Discover the CPUs (MADT, else MP table) and start every application
+// processor. Runs on the BSP after the PIT is going and interrupts are on,
+// and before any process has been queued.
+void smp_init(void) {
+    cpu_t* bsp = &cpus[0];
+    bsp->online = 1;
+    cpu_count = 1;
+    
+    int found = discover_madt();
+    if (!found) {
+        cpu_count = 1;              // Drop anything a half-read MADT listed
+        found = discover_mp();
+    }
+    if (!found) {
+        cpu_count = 1;
+        printf_serial("SMP: no MADT or MP table, running on one CPU\n");
+        return;
+    }
+    if (!lapic_init(lapic_base)) {
+        printf_serial("SMP: no local APIC, running on one CPU\n");
+        cpu_count = 1;
+        return;
+    }
+    lapic_enable();
+    
+    // Discovery listed every CPU after the BSP's own slot; drop the BSP's
+    // entry from the list and number the APs from 1
+    bsp->apic_id = lapic_id();
+    int listed = cpu_count;
+    cpu_count = 1;
+    for (int i = 1; i < listed; i++) {
+        if (cpus[i].apic_id != bsp->apic_id) {
+            cpus[cpu_count++].apic_id = cpus[i].apic_id;
+        }
+    }
+    if (cpu_count == 1) {
+        printf_serial("SMP: 1 CPU\n");
+        return;
+    }
+    
+    lapic_timer_calibrate();
+    
+    spinlock_init(&big_lock, "kernel");
+    uint32_t flags = local_irq_save();
+    smp_active = 1;
+    local_irq_restore(flags);
+    
+    int online = 1;
+    for (int i = 1; i < cpu_count; i++) {
+        if (boot_ap(&cpus[i])) {
+            online++;
+            printf_serial("SMP: CPU %d (APIC %u) online\n", i, cpus[i].apic_id);
+        } else {
+            printf_serial("SMP: CPU %d (APIC %u) did not start\n", i, cpus[i].apic_id);
+        }
+    }
+    printf_serial("SMP: %d of %d CPUs online\n", online, cpu_count);
+}
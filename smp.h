@@ -0,0 +1,49 @@
+/* smp.h - Multiprocessor bring-up and per-CPU state */
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "scheduler.h"
+
+#define MAX_CPUS        8
+#define AP_TRAMPOLINE   0x8000   // Real-mode start-up page (SIPI vector 0x08), see ap_boot.S
+#define AP_STACK_ORDER  2        // 16KB boot/idle stack per application processor
+
+// Everything a CPU owns. Each CPU's GDT has a data segment based at its
+// cpu_t (GDT_PERCPU), loaded into GS, so this_cpu() is a single load.
+typedef struct cpu {
+    struct cpu* self;           // Must stay first: this_cpu() reads %gs:0
+    int id;                     // Index into the CPU table, 0 is the BSP
+    uint8_t apic_id;
+    volatile int online;
+    int current_pid;
+    pcb_t* idle;                // Runs when nothing is queued or stealable
+    runqueue_t rq;
+    uint32_t current_tick;      // Ticks the current process has run
+    uint32_t lock_depth;        // Big kernel lock nesting, see irq_save
+    uint32_t tlb_generation;    // paging_tlb_generation() at the last flush
+    uint64_t switch_start_tsc;
+    uint32_t ticks;             // Local timer ticks
+    uint32_t busy_ticks;        // ... of which something other than idle ran
+    uint32_t steals;            // Processes pulled from other run queues
+} cpu_t;
+
+cpu_t* smp_cpu(int id);
+int smp_cpu_count(void);
+
+#ifndef KACCHI_HOST
+static inline cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    __asm__ volatile ("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+#else
+static inline cpu_t* this_cpu(void) {
+    return smp_cpu(0);
+}
+#endif
+
+void smp_init(void);
+void kernel_lock_handoff(uint32_t depth);
+
+#endif
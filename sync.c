@@ -0,0 +1,300 @@
+/* sync.c - Spinlocks, mutexes and semaphores */
+#include "sync.h"
+#include "scheduler.h"
+#include "idt.h"
+#include "io.h"
+
+// Every initialised lock, in initialisation order, for sync_stats
+static lock_stats_t* all_locks = NULL;
+static lock_stats_t** all_locks_tail = &all_locks;
+
+static const char* lock_kind_names[] = { "spin", "mutex", "sem" };
+
+static void lock_register(lock_stats_t* stats, const char* name, lock_kind_t kind) {
+    stats->name = name;
+    stats->kind = kind;
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->spins = 0;
+    stats->wait_ticks = 0;
+    stats->next = NULL;
+    
+    uint32_t irq = irq_save();
+    *all_locks_tail = stats;
+    all_locks_tail = &stats->next;
+    irq_restore(irq);
+}
+
+// --- Spinlocks ---
+
+// Each lock must be initialised exactly once
+void spinlock_init(spinlock_t* lock, const char* name) {
+    lock->next = 0;
+    lock->owner = 0;
+    lock_register(&lock->stats, name, LOCK_SPIN);
+}
+
+// Take a ticket and spin until it is served. The counters are updated
+// while holding the lock, so they need no atomics of their own.
+void spin_lock(spinlock_t* lock) {
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    uint32_t spins = 0;
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        __asm__ volatile ("pause");
+        spins++;
+    }
+    lock->stats.acquisitions++;
+    if (spins) {
+        lock->stats.contended++;
+        lock->stats.spins += spins;
+    }
+}
+
+// Take the lock only if nobody holds or is queued for it
+int spin_trylock(spinlock_t* lock) {
+    uint16_t owner = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE);
+    uint16_t expected = owner;
+    if (!__atomic_compare_exchange_n(&lock->next, &expected, (uint16_t)(owner + 1), 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    lock->stats.acquisitions++;
+    return 1;
+}
+
+void spin_unlock(spinlock_t* lock) {
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+// For locks also taken from interrupt handlers: this CPU's interrupts stay
+// off while it is held, so a handler cannot spin on its own CPU's lock
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = local_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock(lock);
+    local_irq_restore(flags);
+}
+
+// --- Wait queues ---
+
+static void wait_enqueue(wait_queue_t* queue, pcb_t* process) {
+    process->wait_next = NULL;
+    process->wait_queue = queue;
+    if (queue->tail) {
+        queue->tail->wait_next = process;
+    } else {
+        queue->head = process;
+    }
+    queue->tail = process;
+}
+
+static pcb_t* wait_dequeue(wait_queue_t* queue) {
+    pcb_t* process = queue->head;
+    if (!process) return NULL;
+    queue->head = process->wait_next;
+    if (!queue->head) queue->tail = NULL;
+    process->wait_next = NULL;
+    process->wait_queue = NULL;
+    return process;
+}
+
+// Unlink `process` from `queue`
+static void wait_remove(wait_queue_t* queue, pcb_t* process) {
+    pcb_t* prev = NULL;
+    for (pcb_t* p = queue->head; p; prev = p, p = p->wait_next) {
+        if (p != process) continue;
+        if (prev) {
+            prev->wait_next = p->wait_next;
+        } else {
+            queue->head = p->wait_next;
+        }
+        if (queue->tail == p) queue->tail = prev;
+        break;
+    }
+    process->wait_next = NULL;
+    process->wait_queue = NULL;
+}
+
+void wait_queue_init(wait_queue_t* queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+// Sleep on `queue` until a waker dequeues this process. The caller holds
+// irq_save, so the waker cannot run between queueing and blocking. Returns
+// 0 at once for an idle process, which cannot sleep.
+int wait_queue_sleep(wait_queue_t* queue, wait_reason_t reason) {
+    pcb_t* current = get_current_process();
+    if (!current || scheduler_is_idle(current)) return 0;
+    
+    wait_enqueue(queue, current);
+    block_current_process(reason, IPC_WAIT_FOREVER);
+    return 1;
+}
+
+// Make every sleeper runnable; returns how many there were
+int wait_queue_wake_all(wait_queue_t* queue) {
+    int woken = 0;
+    pcb_t* process;
+    while ((process = wait_dequeue(queue))) {
+        wake_process(process);
+        woken++;
+    }
+    return woken;
+}
+
+// Sleep until the waker hands over what the lock waited for. An idle
+// process cannot sleep, and carrying on would mean entering the critical
+// section without the lock, so that is fatal.
+static void wait_on(wait_queue_t* queue, lock_stats_t* stats, wait_reason_t reason) {
+    uint32_t start = get_ticks();
+    if (!wait_queue_sleep(queue, reason)) {
+        printf_serial("Error: idle process cannot sleep on %s\n", stats->name);
+        panic("Blocking lock taken by an idle process");
+    }
+    stats->contended++;
+    stats->wait_ticks += get_ticks() - start;
+}
+
+// --- Mutexes ---
+
+void mutex_init(mutex_t* mutex, const char* name) {
+    mutex->owner = -1;
+    wait_queue_init(&mutex->waiters);
+    lock_register(&mutex->stats, name, LOCK_MUTEX);
+}
+
+// Pass `mutex` to its longest waiter, or free it if there is none
+static void mutex_release(mutex_t* mutex) {
+    pcb_t* next = wait_dequeue(&mutex->waiters);
+    if (next) {
+        mutex->owner = next->pid;
+        wake_process(next);
+    } else {
+        mutex->owner = -1;
+    }
+}
+
+void mutex_lock(mutex_t* mutex) {
+    uint32_t irq = irq_save();
+    if (mutex->owner == -1) {
+        mutex->owner = get_current_pid();
+    } else {
+        wait_on(&mutex->waiters, &mutex->stats, WAIT_MUTEX);
+    }
+    // Either way the caller owns it now: mutex_unlock hands it over
+    mutex->stats.acquisitions++;
+    irq_restore(irq);
+}
+
+int mutex_trylock(mutex_t* mutex) {
+    uint32_t irq = irq_save();
+    int taken = (mutex->owner == -1);
+    if (taken) {
+        mutex->owner = get_current_pid();
+        mutex->stats.acquisitions++;
+    }
+    irq_restore(irq);
+    return taken;
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    uint32_t irq = irq_save();
+    if (mutex->owner != get_current_pid()) {
+        printf_serial("Error: PID %d does not hold mutex %s\n", get_current_pid(), mutex->stats.name);
+        irq_restore(irq);
+        return;
+    }
+    
+    mutex_release(mutex);
+    irq_restore(irq);
+}
+
+// A terminating process gives up every mutex it holds, including one
+// handed to it while it was still asleep, so the waiters do not hang
+static void mutex_abort(pcb_t* process) {
+    for (lock_stats_t* s = all_locks; s; s = s->next) {
+        if (s->kind != LOCK_MUTEX) continue;
+        mutex_t* mutex = (mutex_t*)((char*)s - __builtin_offsetof(mutex_t, stats));
+        if (mutex->owner != process->pid) continue;
+        printf_serial("Warning: PID %d exited holding mutex %s\n", process->pid, s->name);
+        mutex_release(mutex);
+    }
+}
+
+// --- Semaphores ---
+
+void semaphore_init(semaphore_t* sem, const char* name, int count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+    lock_register(&sem->stats, name, LOCK_SEMAPHORE);
+}
+
+// Hand a unit to the longest waiter, or bank it in the count. The waiter
+// holds it in sem_unit until it runs, so termination can pass it on.
+static void semaphore_give(semaphore_t* sem) {
+    pcb_t* next = wait_dequeue(&sem->waiters);
+    if (next) {
+        next->sem_unit = sem;
+        wake_process(next);
+    } else {
+        sem->count++;
+    }
+}
+
+void semaphore_wait(semaphore_t* sem) {
+    uint32_t irq = irq_save();
+    if (sem->count > 0) {
+        sem->count--;
+    } else {
+        wait_on(&sem->waiters, &sem->stats, WAIT_SEMAPHORE);
+        get_current_process()->sem_unit = NULL;  // Taken
+    }
+    sem->stats.acquisitions++;
+    irq_restore(irq);
+}
+
+int semaphore_trywait(semaphore_t* sem) {
+    uint32_t irq = irq_save();
+    int taken = (sem->count > 0);
+    if (taken) {
+        sem->count--;
+        sem->stats.acquisitions++;
+    }
+    irq_restore(irq);
+    return taken;
+}
+
+void semaphore_post(semaphore_t* sem) {
+    uint32_t irq = irq_save();
+    semaphore_give(sem);
+    irq_restore(irq);
+}
+
+// Take a terminating process off whatever wait queue it sleeps on, release
+// the mutexes it owns and pass on a semaphore unit it was woken with but
+// never took. Called under irq_save.
+void sync_abort(pcb_t* process) {
+    wait_queue_t* queue = process->wait_queue;
+    if (queue) wait_remove(queue, process);
+    mutex_abort(process);
+    if (process->sem_unit) {
+        semaphore_give(process->sem_unit);
+        process->sem_unit = NULL;
+    }
+}
+
+void sync_stats(void) {
+    printf_serial("=== Lock Statistics ===\n");
+    printf_serial("Name\t\tKind\tAcquired\tContended\tSpins\tWait ticks\n");
+    uint32_t irq = irq_save();
+    for (lock_stats_t* s = all_locks; s; s = s->next) {
+        printf_serial("%s\t\t%s\t%u\t\t%u\t\t%u\t%u\n", s->name, lock_kind_names[s->kind],
+                      s->acquisitions, s->contended, s->spins, s->wait_ticks);
+    }
+    irq_restore(irq);
+}
@@ -0,0 +1,82 @@
+/* sync.h - Spinlocks, mutexes and semaphores */
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "types.h"
+#include "process.h"
+
+// Contention counters every lock keeps. Locks register themselves when
+// initialised so sync_stats can list them all.
+typedef enum {
+    LOCK_SPIN,
+    LOCK_MUTEX,
+    LOCK_SEMAPHORE
+} lock_kind_t;
+
+typedef struct lock_stats {
+    const char* name;
+    lock_kind_t kind;
+    uint32_t acquisitions;
+    uint32_t contended;         // Acquisitions that had to spin or sleep
+    uint32_t spins;             // Spinlock: pause iterations spent waiting
+    uint32_t wait_ticks;        // Mutex/semaphore: ticks spent blocked
+    struct lock_stats* next;
+} lock_stats_t;
+
+// Ticket spinlock: FIFO between CPUs, never sleeps. Hold it only for short
+// sections; the irqsave variants also keep this CPU's interrupts off.
+typedef struct {
+    volatile uint16_t next;     // Next ticket to hand out
+    volatile uint16_t owner;    // Ticket now being served
+    lock_stats_t stats;
+} spinlock_t;
+
+// FIFO of processes BLOCKED on one object, linked through pcb->wait_next
+typedef struct wait_queue {
+    pcb_t* head;
+    pcb_t* tail;
+} wait_queue_t;
+
+// Sleeping mutex. Unlock hands ownership straight to the longest waiter,
+// so a stream of lockers cannot starve it.
+typedef struct {
+    int owner;                  // PID of the holder, -1 when free
+    wait_queue_t waiters;
+    lock_stats_t stats;
+} mutex_t;
+
+// Counting semaphore; a post with waiters hands its unit to the first one
+typedef struct semaphore {
+    int count;
+    wait_queue_t waiters;
+    lock_stats_t stats;
+} semaphore_t;
+
+void spinlock_init(spinlock_t* lock, const char* name);
+void spin_lock(spinlock_t* lock);
+int spin_trylock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+
+void mutex_init(mutex_t* mutex, const char* name);
+void mutex_lock(mutex_t* mutex);
+int mutex_trylock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+void semaphore_init(semaphore_t* sem, const char* name, int count);
+void semaphore_wait(semaphore_t* sem);
+int semaphore_trywait(semaphore_t* sem);
+void semaphore_post(semaphore_t* sem);
+
+// Wait queues on their own, for conditions other than the locks above. The
+// caller holds irq_save, sleeps while its condition is false, and rechecks
+// it after every wake-up.
+void wait_queue_init(wait_queue_t* queue);
+int wait_queue_sleep(wait_queue_t* queue, wait_reason_t reason);
+int wait_queue_wake_all(wait_queue_t* queue);
+
+void sync_abort(pcb_t* process);
+void sync_stats(void);
+
+#endif
@@ -0,0 +1,105 @@
+/* logdecode.c - Decode the kernel's binary log frames on the host
+
+   Reads a serial capture (a file, or stdin) taken with log_set_binary(1),
+   passes ordinary console text through and replaces every log frame with
+   its formatted message:
+
+       [   +cycles] cpuN sub.level: message
+
+   Timestamps are TSC cycles since the first frame; -m MHZ prints
+   microseconds instead. Gaps in the sequence numbers (frames lost on the
+   wire) are reported. Build with `make log-decode`. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../log_formats.h"
+
+// Mirrors log_record_t in log.h
+typedef struct {
+    uint32_t seq;
+    uint32_t tsc_lo;
+    uint32_t tsc_hi;
+    uint16_t id;
+    uint8_t sub_level;
+    uint8_t cpu_nargs;
+    uint32_t args[LOG_MAX_ARGS];
+} __attribute__((packed)) record_t;
+
+#define FORMAT_ENTRY(id, format) format,
+static const char* const formats[] = { LOG_FORMATS(FORMAT_ENTRY) };
+#define NAME_ENTRY(id, name) name,
+static const char* const subsystems[] = { LOG_SUBSYSTEMS(NAME_ENTRY) };
+static const char* const levels[] = { LOG_LEVELS(NAME_ENTRY) };
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static double mhz = 0;
+static uint64_t first_tsc = 0;
+static uint32_t last_seq = 0;
+static unsigned long frames = 0, bad = 0, missing = 0;
+
+static void print_record(const record_t* r) {
+    unsigned sub = r->sub_level >> 4, level = r->sub_level & 0xF;
+    unsigned cpu = r->cpu_nargs >> 4;
+    if (r->id >= COUNT(formats) || sub >= COUNT(subsystems) || level >= COUNT(levels)) {
+        bad++;
+        return;
+    }
+
+    uint64_t tsc = (uint64_t)r->tsc_hi << 32 | r->tsc_lo;
+    if (!frames++) first_tsc = tsc;
+    if (last_seq && r->seq != last_seq + 1) {
+        printf("[log] %u records missing\n", r->seq - last_seq - 1);
+        missing += r->seq - last_seq - 1;
+    }
+    last_seq = r->seq;
+
+    uint64_t delta = tsc - first_tsc;
+    if (mhz > 0) {
+        printf("[%12.1fus] ", delta / mhz);
+    } else {
+        printf("[%14llu] ", (unsigned long long)delta);
+    }
+    printf("cpu%u %s.%s: ", cpu, subsystems[sub], levels[level]);
+    printf(formats[r->id], r->args[0], r->args[1], r->args[2], r->args[3]);
+    putchar('\n');
+}
+
+int main(int argc, char** argv) {
+    FILE* in = stdin;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            mhz = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-m MHZ] [capture]\n", argv[0]);
+            return 2;
+        } else if (!(in = fopen(argv[i], "rb"))) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    int c;
+    while ((c = getc(in)) != EOF) {
+        if (c != LOG_FRAME_MAGIC0) {
+            putchar(c);
+            continue;
+        }
+        int next = getc(in);
+        if (next != LOG_FRAME_MAGIC1) {
+            putchar(c);
+            if (next != EOF) ungetc(next, in);
+            continue;
+        }
+        record_t r;
+        if (fread(&r, sizeof(r), 1, in) != 1) {
+            bad++;
+            break;
+        }
+        print_record(&r);
+    }
+
+    fprintf(stderr, "%lu frames decoded, %lu malformed, %lu missing\n", frames, bad, missing);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""schedtrace.py - Analyse a scheduler trace dumped by trace_dump (trace.c)
+
+Reads a serial capture containing the binary trace frame (for example
+`make clean && make run TRACE=1 > capture.bin`) and prints, per process:
+switch-ins and rate, CPU time, time spent READY, and wakeup-to-run latency,
+followed by log2 latency histograms. With -o it also writes a Chrome trace
+JSON timeline (one track per CPU) that chrome://tracing and Perfetto load.
+
+TSC cycles are converted with the rate in the frame header, else --mhz,
+else 1000 MHz (so cycles read as nanoseconds).
+
+    tools/schedtrace.py capture.bin [-o trace.json] [--mhz 2400]
+"""
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"\x1bT"
+HEADER = struct.Struct("<HHIIII")       # version, event size, events, overwritten, TSC kHz, names
+EVENT = struct.Struct("<IIBBBBhh")      # tsc lo/hi, type, cpu, arg, reserved, pid, other
+NAME_LEN = 32                           # PROCESS_NAME_LEN
+VERSION = 1
+
+ENQUEUE, DEQUEUE, SWITCH_OUT, SWITCH_IN, BLOCK, WAKE, TERMINATE = range(7)
+WAIT_NAMES = ["none", "message", "call", "send", "reply", "period", "throttled",
+              "mutex", "semaphore", "input", "sleep"]
+
+
+def find_frame(data):
+    """Return (header, names, events) for the last well-formed frame."""
+    pos = data.rfind(MAGIC)
+    while pos >= 0:
+        start = pos + len(MAGIC)
+        if start + HEADER.size <= len(data):
+            version, size, count, overwritten, khz, nnames = HEADER.unpack_from(data, start)
+            body = start + HEADER.size
+            end = body + nnames * (4 + NAME_LEN) + count * EVENT.size
+            if version == VERSION and size == EVENT.size and end <= len(data):
+                names = {}
+                for _ in range(nnames):
+                    pid, = struct.unpack_from("<i", data, body)
+                    raw = data[body + 4:body + 4 + NAME_LEN]
+                    names[pid] = raw.split(b"\0", 1)[0].decode("ascii", "replace")
+                    body += 4 + NAME_LEN
+                events = []
+                for _ in range(count):
+                    lo, hi, kind, cpu, arg, _, pid, other = EVENT.unpack_from(data, body)
+                    events.append((hi << 32 | lo, kind, cpu, arg, pid, other))
+                    body += EVENT.size
+                return (version, count, overwritten, khz), names, events
+        pos = data.rfind(MAGIC, 0, pos)
+    return None
+
+
+def histogram(title, samples, unit):
+    print(f"\n{title} ({len(samples)} samples, {unit})")
+    if not samples:
+        return
+    buckets = {}
+    for s in samples:
+        b = max(0, int(s).bit_length() - 1)
+        buckets[b] = buckets.get(b, 0) + 1
+    peak = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        lo, hi = (0 if b == 0 else 1 << b), (2 << b) - 1
+        print(f"  {lo:>9}-{hi:<9} {n:>7} {'#' * (n * 50 // peak)}")
+    ordered = sorted(samples)
+    pick = lambda q: ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+    print(f"  p50 {pick(0.50):.0f}  p99 {pick(0.99):.0f}  max {ordered[-1]:.0f}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("capture")
+    ap.add_argument("-o", "--output", help="write a Chrome trace JSON timeline")
+    ap.add_argument("--mhz", type=float, help="TSC rate, if the frame does not carry one")
+    args = ap.parse_args()
+
+    with open(args.capture, "rb") as f:
+        frame = find_frame(f.read())
+    if not frame:
+        sys.exit("no trace frame found")
+    (_, count, overwritten, khz), names, events = frame
+    if not events:
+        sys.exit("trace frame is empty")
+
+    mhz = khz / 1000.0 if khz else (args.mhz or 1000.0)
+    if not khz and not args.mhz:
+        print("warning: no TSC rate in the frame; assuming 1000 MHz", file=sys.stderr)
+    t0 = events[0][0]
+    us = lambda tsc: (tsc - t0) / mhz
+    label = lambda pid: names.get(pid, "idle" if pid <= 0 else f"PID {pid}")
+
+    print(f"{count} events over {us(events[-1][0]) / 1000:.1f} ms"
+          f" ({overwritten} older ones overwritten), TSC {mhz:.0f} MHz")
+
+    stats = {}
+    ready_since, woken_at, running = {}, {}, {}
+    ready_lat, wake_lat = [], []
+    slices, instants = [], []
+
+    def st(pid):
+        return stats.setdefault(pid, {"switches": 0, "run": 0.0, "ready": 0.0,
+                                      "ready_max": 0.0, "wake_max": 0.0})
+
+    for tsc, kind, cpu, arg, pid, other in events:
+        t = us(tsc)
+        if kind == ENQUEUE:
+            ready_since.setdefault(pid, t)
+        elif kind == SWITCH_IN:
+            s = st(pid)
+            s["switches"] += 1
+            if pid in ready_since:
+                waited = t - ready_since.pop(pid)
+                s["ready"] += waited
+                s["ready_max"] = max(s["ready_max"], waited)
+                ready_lat.append(waited)
+            if pid in woken_at:
+                lat = t - woken_at.pop(pid)
+                s["wake_max"] = max(s["wake_max"], lat)
+                wake_lat.append(lat)
+            running[cpu] = (pid, t)
+        elif kind == SWITCH_OUT:
+            if cpu in running and running[cpu][0] == pid:
+                start = running.pop(cpu)[1]
+                st(pid)["run"] += t - start
+                slices.append((cpu, pid, start, t - start))
+        elif kind == WAKE:
+            woken_at[pid] = t
+            instants.append((cpu, f"wake {label(pid)}", t, {"waker": other}))
+        elif kind == BLOCK:
+            ready_since.pop(pid, None)
+            reason = WAIT_NAMES[arg] if arg < len(WAIT_NAMES) else str(arg)
+            instants.append((cpu, f"block {label(pid)}", t, {"reason": reason}))
+        elif kind == TERMINATE:
+            ready_since.pop(pid, None)
+            woken_at.pop(pid, None)
+            instants.append((cpu, f"exit {label(pid)}", t, {}))
+
+    span_s = max(us(events[-1][0]), 1.0) / 1e6
+    print(f"\n{'PID':>5} {'Name':<16} {'Switches':>8} {'Rate/s':>8} {'CPU ms':>9}"
+          f" {'Ready ms':>9} {'Max ready us':>12} {'Max wake us':>11}")
+    for pid in sorted(stats):
+        s = stats[pid]
+        print(f"{pid:>5} {label(pid):<16} {s['switches']:>8} {s['switches'] / span_s:>8.1f}"
+              f" {s['run'] / 1000:>9.2f} {s['ready'] / 1000:>9.2f}"
+              f" {s['ready_max']:>12.1f} {s['wake_max']:>11.1f}")
+
+    histogram("Time in READY before running", [x * 1000 for x in ready_lat], "ns")
+    histogram("Wakeup-to-run latency", [x * 1000 for x in wake_lat], "ns")
+
+    if args.output:
+        trace = []
+        for cpu in sorted({e[2] for e in events}):
+            trace.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+                          "args": {"name": f"CPU {cpu}"}})
+        for cpu, pid, start, dur in slices:
+            trace.append({"name": label(pid), "cat": "run", "ph": "X", "pid": 0, "tid": cpu,
+                          "ts": start, "dur": dur, "args": {"pid": pid}})
+        for cpu, name, t, extra in instants:
+            trace.append({"name": name, "cat": "sched", "ph": "i", "s": "t", "pid": 0,
+                          "tid": cpu, "ts": t, "args": extra})
+        with open(args.output, "w") as f:
+            json.dump({"traceEvents": trace, "displayTimeUnit": "ms"}, f)
+        print(f"\nWrote {len(trace)} timeline events to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
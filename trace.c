@@ -0,0 +1,98 @@
+/* trace.c - Scheduler event trace
+
+   Frame sent by trace_dump, all little-endian:
+       TRACE_FRAME_MAGIC0, TRACE_FRAME_MAGIC1
+       header:  u16 version, u16 sizeof(trace_event_t), u32 events,
+                u32 overwritten, u32 TSC kHz (0 if unknown), u32 names
+       names:   i32 pid, char name[PROCESS_NAME_LEN], one per live process
+       events:  trace_event_t, oldest first */
+#include "trace.h"
+#include "process.h"
+#include "smp.h"
+#include "pit.h"
+#include "io.h"
+
+typedef struct {
+    uint16_t version;
+    uint16_t event_size;
+    uint32_t events;
+    uint32_t overwritten;
+    uint32_t tsc_khz;
+    uint32_t names;
+} trace_header_t;
+
+#define TRACE_DUMP_CHUNK 64        // Events per serial_write
+
+static trace_event_t events[TRACE_EVENTS];
+static uint32_t trace_head = 0;    // Events recorded since trace_clear
+int trace_on = 0;
+
+void trace_record(trace_type_t type, int pid, int other, uint32_t arg) {
+    trace_event_t* e = &events[trace_head++ & (TRACE_EVENTS - 1)];
+    uint64_t tsc = rdtsc();
+    e->tsc_lo = (uint32_t)tsc;
+    e->tsc_hi = (uint32_t)(tsc >> 32);
+    e->type = (uint8_t)type;
+    e->cpu = (uint8_t)this_cpu()->id;
+    e->arg = (uint8_t)arg;
+    e->reserved = 0;
+    e->pid = (int16_t)pid;
+    e->other = (int16_t)other;
+}
+
+void trace_enable(int enable) {
+    uint32_t irq = irq_save();
+    trace_on = enable;
+    irq_restore(irq);
+}
+
+void trace_clear(void) {
+    uint32_t irq = irq_save();
+    trace_head = 0;
+    irq_restore(irq);
+}
+
+// Tracing pauses for the dump so the buffer holds still; interrupts are
+// let in between chunks, since at 38400 baud a full buffer takes seconds
+void trace_dump(void) {
+    uint32_t irq = irq_save();
+    int was_on = trace_on;
+    trace_on = 0;
+    uint32_t count = trace_head < TRACE_EVENTS ? trace_head : TRACE_EVENTS;
+    uint32_t first = trace_head - count;
+    
+    uint32_t names = 0;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        if (get_process_slot(i)) names++;
+    }
+    
+    uint8_t magic[2] = { TRACE_FRAME_MAGIC0, TRACE_FRAME_MAGIC1 };
+    trace_header_t header = { TRACE_VERSION, sizeof(trace_event_t), count,
+                              trace_head - count, tsc_khz(), names };
+    serial_write(magic, sizeof(magic));
+    serial_write(&header, sizeof(header));
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pcb_t* proc = get_process_slot(i);
+        if (!proc) continue;
+        int32_t pid = proc->pid;
+        serial_write(&pid, sizeof(pid));
+        serial_write(proc->name, PROCESS_NAME_LEN);
+    }
+    irq_restore(irq);
+    
+    for (uint32_t i = 0; i < count; ) {
+        irq = irq_save();
+        for (uint32_t n = 0; n < TRACE_DUMP_CHUNK && i < count; n++, i++) {
+            serial_write(&events[(first + i) & (TRACE_EVENTS - 1)], sizeof(trace_event_t));
+        }
+        irq_restore(irq);
+    }
+    
+    trace_enable(was_on);
+}
+
+void trace_stats(void) {
+    uint32_t overwritten = trace_head > TRACE_EVENTS ? trace_head - TRACE_EVENTS : 0;
+    printf_serial("Trace: %s, %u events recorded, %u overwritten\n",
+                  trace_on ? "ON" : "OFF", trace_head, overwritten);
+}
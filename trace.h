@@ -0,0 +1,51 @@
+/* trace.h - Scheduler event trace */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+// Fixed-size buffer of scheduler events, oldest overwritten first. Events
+// are recorded from inside the scheduler's irq_save sections, so recording
+// needs no atomics. trace_dump sends the buffer over serial as one binary
+// frame for tools/schedtrace.py.
+#define TRACE_EVENTS 4096          // Power of two
+#define TRACE_FRAME_MAGIC0 0x1B
+#define TRACE_FRAME_MAGIC1 'T'
+#define TRACE_VERSION 1
+
+typedef enum {
+    TRACE_ENQUEUE,      // arg: run-queue level
+    TRACE_DEQUEUE,
+    TRACE_SWITCH_OUT,   // other: incoming PID, arg: outgoing state
+    TRACE_SWITCH_IN,    // other: outgoing PID
+    TRACE_BLOCK,        // arg: wait reason
+    TRACE_WAKE,         // other: waker PID
+    TRACE_TERMINATE
+} trace_type_t;
+
+// 16 bytes, little-endian; the frame layout is described in trace.c
+typedef struct {
+    uint32_t tsc_lo;
+    uint32_t tsc_hi;
+    uint8_t type;
+    uint8_t cpu;
+    uint8_t arg;
+    uint8_t reserved;
+    int16_t pid;
+    int16_t other;
+} trace_event_t;
+
+extern int trace_on;
+
+void trace_record(trace_type_t type, int pid, int other, uint32_t arg);
+
+static inline void trace(trace_type_t type, int pid, int other, uint32_t arg) {
+    if (trace_on) trace_record(type, pid, other, arg);
+}
+
+void trace_enable(int enable);
+void trace_clear(void);
+void trace_dump(void);
+void trace_stats(void);
+
+#endif
@@ -1,54 +1,63 @@
-/* types.h - Basic type definitions and utilities */
-#ifndef TYPES_H
-#define TYPES_H
-
-typedef unsigned int   uint32_t;
-typedef unsigned short uint16_t;
-typedef unsigned char  uint8_t;
-typedef int            int32_t;
-typedef short          int16_t;
-typedef char           int8_t;
-
-typedef uint32_t size_t;
-
-#define NULL  ((void*)0)
-
-// String and memory utilities (inline for efficiency)
-static inline size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
-}
-
-static inline int strcmp(const char* str1, const char* str2) {
-    while (*str1 && (*str1 == *str2)) {
-        str1++;
-        str2++;
-    }
-    return *(unsigned char*)str1 - *(unsigned char*)str2;
-}
-
-static inline char* strcpy(char* dest, const char* src) {
-    char* original_dest = dest;
-    while ((*dest++ = *src++));
-    return original_dest;
-}
-
-static inline void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    while (n--) {
-        *d++ = *s++;
-    }
-    return dest;
-}
-
-static inline void* memset(void* s, int c, size_t n) {
-    unsigned char* p = (unsigned char*)s;
-    while (n--) {
-        *p++ = (unsigned char)c;
-    }
-    return s;
-}
-
-#endif
+/* types.h - Basic type definitions and utilities */
+#ifndef TYPES_H
+#define TYPES_H
+
+typedef unsigned int   uint32_t;
+typedef unsigned short uint16_t;
+typedef unsigned char  uint8_t;
+typedef int            int32_t;
+typedef short          int16_t;
+typedef char           int8_t;
+typedef unsigned long long uint64_t;
+typedef long long          int64_t;
+
+typedef uint32_t size_t;
+typedef unsigned long uintptr_t;  // Integer wide enough to hold a pointer
+
+#define NULL  ((void*)0)
+
+// String and memory utilities (inline for efficiency)
+static inline size_t strlen(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+static inline int strcmp(const char* str1, const char* str2) {
+    while (*str1 && (*str1 == *str2)) {
+        str1++;
+        str2++;
+    }
+    return *(unsigned char*)str1 - *(unsigned char*)str2;
+}
+
+static inline char* strcpy(char* dest, const char* src) {
+    char* original_dest = dest;
+    while ((*dest++ = *src++));
+    return original_dest;
+}
+
+// 64-by-32 division; the kernel is not linked against libgcc's __udivdi3
+static inline uint64_t div64_32(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t q_hi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t q_lo;
+    __asm__ ("divl %2" : "=a"(q_lo), "+d"(r) : "rm"(d), "a"((uint32_t)n));
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+// part / whole in tenths of a percent, for part <= whole
+static inline uint32_t permille(uint64_t part, uint64_t whole) {
+    while (whole >> 32) {
+        part >>= 1;
+        whole >>= 1;
+    }
+    return whole ? (uint32_t)div64_32(part * 1000, (uint32_t)whole) : 0;
+}
+
+// Block copy and fill (memops.c)
+void* memcpy(void* dest, const void* src, size_t n);
+void* memset(void* s, int c, size_t n);
+
+#endif